@@ -10,8 +10,14 @@
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
+#include <limits.h>
 #include <float.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BTREE_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
 
 //==============================================================================
 // Noise
@@ -906,23 +912,53 @@ static int init_climate_seed(
     return n;
 }
 
-void setBiomeSeed(BiomeNoise *bn, uint64_t seed, int large)
+// Each climate has a fixed place in the octave buffer, so that the climates
+// can be initialized in any order.
+static const int climate_oct[NP_MAX+1] = { 0, 4, 8, 26, 34, 40, 46 };
+
+void setBiomeSeedLazy(BiomeNoise *bn, uint64_t seed, int large)
 {
     Xoroshiro pxr;
     xSetSeed(&pxr, seed);
-    uint64_t xlo = xNextLong(&pxr);
-    uint64_t xhi = xNextLong(&pxr);
-
-    int n = 0, i = 0;
-    for (; i < NP_MAX; i++)
-        n += init_climate_seed(&bn->climate[i], bn->oct+n, xlo, xhi, large, i, -1);
+    bn->xlo = xNextLong(&pxr);
+    bn->xhi = xNextLong(&pxr);
+    bn->large = large;
+    bn->lazy = (1U << NP_MAX) - 1;
+    bn->nptype = -1;
+}
 
-    if ((size_t)n > sizeof(bn->oct) / sizeof(*bn->oct))
+void initClimates(BiomeNoise *bn, uint32_t npmask)
+{
+    int i;
+    for (i = 0; i < NP_MAX; i++)
     {
-        printf("setBiomeSeed(): BiomeNoise is malformed, buffer too small\n");
-        exit(1);
+        if (!(bn->lazy & npmask & (1U << i)))
+            continue;
+        int n = init_climate_seed(&bn->climate[i], bn->oct + climate_oct[i],
+            bn->xlo, bn->xhi, bn->large, i, -1);
+        if (n != climate_oct[i+1] - climate_oct[i] ||
+            (size_t)climate_oct[i+1] > sizeof(bn->oct) / sizeof(*bn->oct))
+        {
+            printf("setBiomeSeed(): BiomeNoise is malformed, buffer too small\n");
+            exit(1);
+        }
     }
-    bn->nptype = -1;
+    bn->lazy &= ~npmask;
+}
+
+void setBiomeSeed(BiomeNoise *bn, uint64_t seed, int large)
+{
+    setBiomeSeedLazy(bn, seed, large);
+    initClimates(bn, (1U << NP_MAX) - 1);
+}
+
+/* Initializes the climates that are still pending for a lazily seeded
+ * BiomeNoise upon their first use.
+ */
+static inline void useClimates(const BiomeNoise *bn, uint32_t npmask)
+{
+    if (bn->lazy & npmask)
+        initClimates((BiomeNoise*) bn, npmask);
 }
 
 void setBetaBiomeSeed(BiomeNoiseBeta *bnb, uint64_t seed)
@@ -1134,55 +1170,80 @@ void initBiomeNoise(BiomeNoise *bn, int mc)
 
     bn->sp = sp;
     bn->mc = mc;
+    bn->lazy = 0;
+    bn->f32 = 0;
 }
 
 
-/// Biome sampler for MC 1.18
-int sampleBiomeNoise(const BiomeNoise *bn, int64_t *np, int x, int y, int z,
-    uint64_t *dat, uint32_t sample_flags)
+static inline double sampleClimate(const BiomeNoise *bn, int id,
+    double x, double y, double z, uint32_t sample_flags)
 {
-    if (bn->nptype >= 0)
-    {   // initialized for a specific climate parameter
-        if (np)
-            memset(np, 0, NP_MAX*sizeof(*np));
-        int64_t id = (int64_t) (10000.0 * sampleClimatePara(bn, np, x, z));
-        return (int) id;
-    }
+    if (sample_flags & SAMPLE_FLOAT32)
+        return sampleDoublePerlinF(&bn->climate[id], x, y, z);
+    return sampleDoublePerlin(&bn->climate[id], x, y, z);
+}
+
+/// Gets the y-independent spline offset of the depth from the column climates.
+static float getColumnOffset(const BiomeNoise *bn, const float cl[NP_MAX])
+{
+    float w = cl[NP_WEIRDNESS];
+    float np_param[] = {
+        cl[NP_CONTINENTALNESS], cl[NP_EROSION],
+        -3.0F * ( fabsf( fabsf(w) - 0.6666667F ) - 0.33333334F ), w,
+    };
+    return getSpline(bn->sp, np_param) + 0.015F;
+}
+
+/* Samples the climates at a horizontal position. None of them depend on y, so
+ * the depth slot cl[NP_DEPTH] receives the y-independent spline offset instead.
+ */
+static void sampleClimateColumn(const BiomeNoise *bn, float cl[NP_MAX],
+    int x, int z, uint32_t sample_flags)
+{
+    if (sample_flags & SAMPLE_NO_SHIFT)
+        useClimates(bn, ((1U << NP_MAX) - 1) & ~(1U << NP_SHIFT));
+    else
+        useClimates(bn, (1U << NP_MAX) - 1);
 
-    float t = 0, h = 0, c = 0, e = 0, d = 0, w = 0;
     double px = x, pz = z;
     if (!(sample_flags & SAMPLE_NO_SHIFT))
     {
-        px += sampleDoublePerlin(&bn->climate[NP_SHIFT], x, 0, z) * 4.0;
-        pz += sampleDoublePerlin(&bn->climate[NP_SHIFT], z, x, 0) * 4.0;
+        px += sampleClimate(bn, NP_SHIFT, x, 0, z, sample_flags) * 4.0;
+        pz += sampleClimate(bn, NP_SHIFT, z, x, 0, sample_flags) * 4.0;
     }
 
-    c = sampleDoublePerlin(&bn->climate[NP_CONTINENTALNESS], px, 0, pz);
-    e = sampleDoublePerlin(&bn->climate[NP_EROSION], px, 0, pz);
-    w = sampleDoublePerlin(&bn->climate[NP_WEIRDNESS], px, 0, pz);
+    cl[NP_CONTINENTALNESS] = sampleClimate(bn, NP_CONTINENTALNESS, px, 0, pz, sample_flags);
+    cl[NP_EROSION] = sampleClimate(bn, NP_EROSION, px, 0, pz, sample_flags);
+    cl[NP_WEIRDNESS] = sampleClimate(bn, NP_WEIRDNESS, px, 0, pz, sample_flags);
+    cl[NP_DEPTH] = 0;
 
     if (!(sample_flags & SAMPLE_NO_DEPTH))
-    {
-        float np_param[] = {
-            c, e, -3.0F * ( fabsf( fabsf(w) - 0.6666667F ) - 0.33333334F ), w,
-        };
-        double off = getSpline(bn->sp, np_param) + 0.015F;
+        cl[NP_DEPTH] = getColumnOffset(bn, cl);
+
+    cl[NP_TEMPERATURE] = sampleClimate(bn, NP_TEMPERATURE, px, 0, pz, sample_flags);
+    cl[NP_HUMIDITY] = sampleClimate(bn, NP_HUMIDITY, px, 0, pz, sample_flags);
+}
 
+/// Maps the column climates from sampleClimateColumn() at height y to a biome.
+static int climateColumnToBiome(const BiomeNoise *bn, int64_t *np,
+    const float cl[NP_MAX], int y, uint64_t *dat, uint32_t sample_flags)
+{
+    float d = 0;
+    if (!(sample_flags & SAMPLE_NO_DEPTH))
+    {
+        double off = cl[NP_DEPTH];
         //double py = y + sampleDoublePerlin(&bn->shift, y, z, x) * 4.0;
         d = 1.0 - (y * 4) / 128.0 - 83.0/160.0 + off;
     }
 
-    t = sampleDoublePerlin(&bn->climate[NP_TEMPERATURE], px, 0, pz);
-    h = sampleDoublePerlin(&bn->climate[NP_HUMIDITY], px, 0, pz);
-
     int64_t l_np[6];
     int64_t *p_np = np ? np : l_np;
-    p_np[0] = (int64_t)(10000.0F*t);
-    p_np[1] = (int64_t)(10000.0F*h);
-    p_np[2] = (int64_t)(10000.0F*c);
-    p_np[3] = (int64_t)(10000.0F*e);
+    p_np[0] = (int64_t)(10000.0F*cl[NP_TEMPERATURE]);
+    p_np[1] = (int64_t)(10000.0F*cl[NP_HUMIDITY]);
+    p_np[2] = (int64_t)(10000.0F*cl[NP_CONTINENTALNESS]);
+    p_np[3] = (int64_t)(10000.0F*cl[NP_EROSION]);
     p_np[4] = (int64_t)(10000.0F*d);
-    p_np[5] = (int64_t)(10000.0F*w);
+    p_np[5] = (int64_t)(10000.0F*cl[NP_WEIRDNESS]);
 
     int id = none;
     if (!(sample_flags & SAMPLE_NO_BIOME))
@@ -1190,6 +1251,109 @@ int sampleBiomeNoise(const BiomeNoise *bn, int64_t *np, int x, int y, int z,
     return id;
 }
 
+/// Biome sampler for MC 1.18
+int sampleBiomeNoise(const BiomeNoise *bn, int64_t *np, int x, int y, int z,
+    uint64_t *dat, uint32_t sample_flags)
+{
+    if (bn->nptype >= 0)
+    {   // initialized for a specific climate parameter
+        if (np)
+            memset(np, 0, NP_MAX*sizeof(*np));
+        int64_t id = (int64_t) (10000.0 * sampleClimatePara(bn, np, x, z));
+        return (int) id;
+    }
+
+    float cl[NP_MAX];
+    sampleClimateColumn(bn, cl, x, z, sample_flags);
+    return climateColumnToBiome(bn, np, cl, y, dat, sample_flags);
+}
+
+/* Refines a climate until its noise parameter is provably inside or outside
+ * of the limits, or until all octaves are sampled if 'full' is set. The
+ * parameter mapping of climateColumnToBiome() is monotonic, so it also maps
+ * the bounds of the partial value.
+ */
+static int refineClimateInLimits(const DoublePerlinNoise *dpn,
+    DoublePerlinPartial *pp, const int plim[2], int full)
+{
+    for (;;)
+    {
+        double err;
+        double v = getDoublePerlinPartial(dpn, pp, &err);
+        int64_t lo = (int64_t)(10000.0F * (float)(v - err));
+        int64_t hi = (int64_t)(10000.0F * (float)(v + err));
+        if (hi < plim[0] || lo > plim[1])
+            return 0;
+        if (err == 0 || (!full && lo >= plim[0] && hi <= plim[1]))
+            return 1;
+        refineDoublePerlin(dpn, pp);
+    }
+}
+
+int sampleBiomeNoiseLimits(const BiomeNoise *bn, const int lim[12],
+    int x, int y, int z, uint32_t sample_flags)
+{
+    // climates with fewer octaves first
+    static const int order[] = {
+        NP_TEMPERATURE, NP_HUMIDITY, NP_WEIRDNESS, NP_EROSION,
+        NP_CONTINENTALNESS,
+    };
+    const int *dlim = lim + 2*NP_DEPTH;
+    int depth = 0;
+    if (sample_flags & SAMPLE_NO_DEPTH)
+    {
+        if (0 < dlim[0] || 0 > dlim[1])
+            return 0;
+    }
+    else
+    {
+        depth = dlim[0] != INT_MIN || dlim[1] != INT_MAX;
+    }
+
+    float cl[NP_MAX];
+    double px = x, pz = z;
+    int i, shifted = 0;
+    for (i = 0; i < (int) (sizeof(order) / sizeof(*order)); i++)
+    {
+        int k = order[i];
+        const int *plim = lim + 2*k;
+        int full = depth && k != NP_TEMPERATURE && k != NP_HUMIDITY;
+        if (!full && plim[0] == INT_MIN && plim[1] == INT_MAX)
+            continue;
+        if (!shifted && !(sample_flags & SAMPLE_NO_SHIFT))
+        {
+            useClimates(bn, 1U << NP_SHIFT);
+            px += sampleDoublePerlin(&bn->climate[NP_SHIFT], x, 0, z) * 4.0;
+            pz += sampleDoublePerlin(&bn->climate[NP_SHIFT], z, x, 0) * 4.0;
+        }
+        shifted = 1;
+
+        useClimates(bn, 1U << k);
+        DoublePerlinPartial pp;
+        initDoublePerlinPartial(&pp, px, 0, pz);
+        if (!refineClimateInLimits(&bn->climate[k], &pp, plim, full))
+            return 0;
+        if (full)
+            cl[k] = getDoublePerlinPartial(&bn->climate[k], &pp, NULL);
+    }
+
+    if (depth)
+    {
+        float c = cl[NP_CONTINENTALNESS];
+        float e = cl[NP_EROSION];
+        float w = cl[NP_WEIRDNESS];
+        float np_param[] = {
+            c, e, -3.0F * ( fabsf( fabsf(w) - 0.6666667F ) - 0.33333334F ), w,
+        };
+        double off = getSpline(bn->sp, np_param) + 0.015F;
+        float d = 1.0 - (y * 4) / 128.0 - 83.0/160.0 + off;
+        int64_t p = (int64_t)(10000.0F*d);
+        if (p < dlim[0] || p > dlim[1])
+            return 0;
+    }
+    return 1;
+}
+
 // Note: Climate noise is sampled at a 1:1 scale.
 int sampleBiomeNoiseBeta(const BiomeNoiseBeta *bnb, int64_t *np, double *nv,
     int x, int z)
@@ -1430,6 +1594,224 @@ int get_resulting_node(const uint64_t np[6], const BiomeTree *bt, int idx,
     return leaf;
 }
 
+/* Compiled form of a BiomeTree: the nodes are stored breadth-first, such that
+ * the children of a node are contiguous, and the parameter bounds are inlined
+ * as a structure of arrays over the six dimensions. This allows the distances
+ * to all the children of a node to be calculated in one go.
+ */
+enum { FLAT_TREE_MAX_ORDER = 12, FLAT_TREE_MAX_DEPTH = 8 };
+
+typedef struct FlatBiomeTree FlatBiomeTree;
+typedef void (flatdist_t)(const FlatBiomeTree*, const int32_t[6], int, int, uint64_t*);
+
+struct FlatBiomeTree
+{
+    int len;
+    int16_t *lo[6], *hi[6];     // parameter bounds
+    uint16_t *first;            // first child
+    uint8_t *cnt;               // number of children, zero for leaves
+    uint16_t *idx;              // index of the node in the BiomeTree
+    flatdist_t *dist;
+};
+
+static void flatDist(const FlatBiomeTree *ft, const int32_t np[6],
+    int first, int cnt, uint64_t *ds)
+{
+    int i, k;
+    for (k = 0; k < cnt; k++)
+    {
+        uint64_t s = 0;
+        for (i = 0; i < 6; i++)
+        {
+            int32_t a = np[i] - ft->hi[i][first+k];
+            int32_t b = ft->lo[i][first+k] - np[i];
+            int64_t d = a > 0 ? a : b > 0 ? b : 0;
+            s += d * d;
+        }
+        ds[k] = s;
+    }
+}
+
+#if BTREE_SIMD_X86
+ATTR(target("avx2"))
+static void flatDistAVX2(const FlatBiomeTree *ft, const int32_t np[6],
+    int first, int cnt, uint64_t *ds)
+{   // processes four children at a time, which may overrun cnt (see padding)
+    const __m128i zero = _mm_setzero_si128();
+    int i, k;
+    for (k = 0; k < cnt; k += 4)
+    {
+        __m256i s = _mm256_setzero_si256();
+        for (i = 0; i < 6; i++)
+        {
+            __m128i lo = _mm_cvtepi16_epi32(
+                _mm_loadl_epi64((const __m128i*) (ft->lo[i] + first + k)));
+            __m128i hi = _mm_cvtepi16_epi32(
+                _mm_loadl_epi64((const __m128i*) (ft->hi[i] + first + k)));
+            __m128i p = _mm_set1_epi32(np[i]);
+            __m128i d = _mm_max_epi32(_mm_sub_epi32(p, hi), _mm_sub_epi32(lo, p));
+            __m256i d64 = _mm256_cvtepi32_epi64(_mm_max_epi32(d, zero));
+            s = _mm256_add_epi64(s, _mm256_mul_epi32(d64, d64));
+        }
+        _mm256_storeu_si256((__m256i*) (ds + k), s);
+    }
+}
+#endif
+
+static FlatBiomeTree *buildFlatBiomeTree(const BiomeTree *bt)
+{
+    typedef struct { int idx, depth; } entry_t;
+    FlatBiomeTree *ft;
+    entry_t *queue;
+    size_t n = bt->len + 4; // padding for vectorized reads
+    int i, k, head, tail;
+
+    if (bt->order > FLAT_TREE_MAX_ORDER || bt->len > 0xffff)
+        return NULL;
+
+    ft = (FlatBiomeTree*) calloc(1, sizeof(*ft) +
+        n * (12*sizeof(int16_t) + 2*sizeof(uint16_t) + sizeof(uint8_t)));
+    queue = (entry_t*) malloc(n * sizeof(*queue));
+    if (!ft || !queue)
+        goto L_fail;
+
+    int16_t *p16 = (int16_t*) (ft + 1);
+    for (i = 0; i < 6; i++)
+    {
+        ft->lo[i] = p16; p16 += n;
+        ft->hi[i] = p16; p16 += n;
+    }
+    ft->first = (uint16_t*) p16;
+    ft->idx = ft->first + n;
+    ft->cnt = (uint8_t*) (ft->idx + n);
+    ft->dist = flatDist;
+#if BTREE_SIMD_X86
+    if (__builtin_cpu_supports("avx2"))
+        ft->dist = flatDistAVX2;
+#endif
+
+    // Replicate the child enumeration of get_resulting_node().
+    head = tail = 0;
+    queue[tail++] = (entry_t) {0, 0};
+    while (head < tail)
+    {
+        entry_t e = queue[head];
+        uint64_t node = bt->nodes[e.idx];
+        ft->idx[head] = e.idx;
+        for (i = 0; i < 6; i++)
+        {
+            int pi = (node >> 8*i) & 0xFF;
+            ft->lo[i][head] = bt->param[2*pi + 0];
+            ft->hi[i][head] = bt->param[2*pi + 1];
+        }
+        head++;
+        if (bt->steps[e.depth] == 0)
+            continue;
+
+        uint32_t step;
+        int depth = e.depth;
+        do
+        {
+            step = bt->steps[depth];
+            depth++;
+        }
+        while (e.idx+step >= bt->len);
+        if (depth >= FLAT_TREE_MAX_DEPTH)
+            goto L_fail;
+
+        uint32_t inner = node >> 48;
+        ft->first[head-1] = tail;
+        for (k = 0; k < (int) bt->order; k++)
+        {
+            if (tail >= (int) bt->len)
+                goto L_fail;
+            queue[tail++] = (entry_t) {(int) inner, depth};
+            inner += step;
+            if (inner >= bt->len)
+            {
+                k++;
+                break;
+            }
+        }
+        ft->cnt[head-1] = k;
+    }
+    ft->len = head;
+    free(queue);
+    return ft;
+
+L_fail:
+    free(queue);
+    free(ft);
+    return NULL;
+}
+
+/* Initializes the compiled tree on first use. Threads that race here build
+ * identical trees, and all but the first one to be published are discarded.
+ */
+static const FlatBiomeTree *getFlatBiomeTree(const BiomeTree *bt,
+    FlatBiomeTree **slot)
+{
+#if __GNUC__
+    FlatBiomeTree *ft = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (ft)
+        return ft;
+    FlatBiomeTree *expect = NULL;
+    ft = buildFlatBiomeTree(bt);
+    if (ft && !__atomic_compare_exchange_n(slot, &expect, ft, 0,
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        free(ft);
+        ft = expect;
+    }
+    return ft;
+#else
+    (void) bt; (void) slot;
+    return NULL; // use the original tree search
+#endif
+}
+
+static int flatBiomeSearch(const FlatBiomeTree *ft, const int32_t np[6],
+    int leaf, uint64_t ds)
+{
+    // This is an iterative version of get_resulting_node() that descends into
+    // a child only if it may contain a leaf closer than the best one so far.
+    struct {
+        int node, k;
+        uint64_t ds[FLAT_TREE_MAX_ORDER];
+    } stack[FLAT_TREE_MAX_DEPTH], *f;
+    int sp = 0;
+
+    f = stack;
+    f->node = 0;
+    f->k = 0;
+    ft->dist(ft, np, ft->first[0], ft->cnt[0], f->ds);
+
+    while (sp >= 0)
+    {
+        f = stack + sp;
+        if (f->k == ft->cnt[f->node])
+        {
+            sp--;
+            continue;
+        }
+        int c = ft->first[f->node] + f->k;
+        uint64_t dc = f->ds[f->k++];
+        if (dc >= ds)
+            continue;
+        if (ft->cnt[c] == 0)
+        {
+            ds = dc;
+            leaf = ft->idx[c];
+            continue;
+        }
+        f = stack + ++sp;
+        f->node = c;
+        f->k = 0;
+        ft->dist(ft, np, ft->first[c], ft->cnt[c], f->ds);
+    }
+    return leaf;
+}
+
 ATTR(hot, flatten)
 int climateToBiome(int mc, const uint64_t np[6], uint64_t *dat)
 {
@@ -1454,21 +1836,47 @@ int climateToBiome(int mc, const uint64_t np[6], uint64_t *dat)
         sizeof(btree21wd_nodes) / sizeof(uint64_t)
     };
 
+    static FlatBiomeTree *flat[5];
+
     const BiomeTree *bt;
-    int idx;
+    FlatBiomeTree **slot;
+    int idx, i;
 
     if (mc >= MC_1_21_WD)
-        bt = &btree21wd;
+        bt = &btree21wd, slot = flat+4;
     else if (mc >= MC_1_20_6)
-        bt = &btree20;
+        bt = &btree20, slot = flat+3;
     else if (mc >= MC_1_19_4)
-        bt = &btree19;
+        bt = &btree19, slot = flat+2;
     else if (mc >= MC_1_19_2)
-        bt = &btree192;
+        bt = &btree192, slot = flat+1;
     else
-        bt = &btree18;
+        bt = &btree18, slot = flat+0;
+
+    const FlatBiomeTree *ft = getFlatBiomeTree(bt, slot);
+    int32_t np32[6];
+    for (i = 0; i < 6 && ft; i++)
+    {   // the compiled search uses 32-bit differences
+        if ((int64_t)np[i] < -(1LL << 28) || (int64_t)np[i] > (1LL << 28))
+            ft = NULL;
+        else
+            np32[i] = (int32_t) np[i];
+    }
 
-    if (dat)
+    if (ft)
+    {
+        if (dat)
+        {
+            int alt = (int) *dat;
+            idx = flatBiomeSearch(ft, np32, alt, get_np_dist(np, bt, alt));
+            *dat = (uint64_t) idx;
+        }
+        else
+        {
+            idx = flatBiomeSearch(ft, np32, 0, -1);
+        }
+    }
+    else if (dat)
     {
         int alt = (int) *dat;
         uint64_t ds = get_np_dist(np, bt, alt);
@@ -1505,12 +1913,15 @@ void setClimateParaSeed(BiomeNoise *bn, uint64_t seed, int large, int nptype, in
         init_climate_seed(bn->climate + nptype, bn->oct, xlo, xhi, large, nptype, nmax);
     }
     bn->nptype = nptype;
+    bn->lazy = 0;
 }
 
 double sampleClimatePara(const BiomeNoise *bn, int64_t *np, double x, double z)
 {
     if (bn->nptype == NP_DEPTH)
     {
+        useClimates(bn, (1U << NP_CONTINENTALNESS) | (1U << NP_EROSION) |
+            (1U << NP_WEIRDNESS));
         float c, e, w;
         c = sampleDoublePerlin(bn->climate + NP_CONTINENTALNESS, x, 0, z);
         e = sampleDoublePerlin(bn->climate + NP_EROSION, x, 0, z);
@@ -1531,6 +1942,7 @@ double sampleClimatePara(const BiomeNoise *bn, int64_t *np, double x, double z)
         }
         return d;
     }
+    useClimates(bn, 1U << bn->nptype);
     double p = sampleDoublePerlin(bn->climate + bn->nptype, x, 0, z);
     if (np)
         np[bn->nptype] = (int64_t)(10000.0F*p);
@@ -1560,15 +1972,187 @@ void genBiomeNoiseChunkSection(const BiomeNoise *bn, int out[4][4][4],
     }
 }
 
+/* Generates a range without local distortions (SAMPLE_NO_SHIFT), for which the
+ * climates lie on a regular lattice that can be sampled plane-wise.
+ */
+static void genBiomeNoiseGrid(const BiomeNoise *bn, int *out, Range r,
+    uint64_t *dat)
+{
+    static const int np_id[] = {
+        NP_TEMPERATURE, NP_HUMIDITY, NP_CONTINENTALNESS, NP_EROSION,
+        NP_WEIRDNESS,
+    };
+    int scale = r.scale > 4 ? r.scale / 4 : 1;
+    int mid = scale / 2;
+    // A single layer is processed in bands of rows. Volumes have to keep all
+    // the columns, because the biomes are mapped layer by layer.
+    int band = (r.sy > 1 || r.sz < 16) ? r.sz : 16;
+    size_t siz = (size_t)r.sx * band;
+    double *buf = (double*) malloc(sizeof(*buf) * siz);
+    float *cl = (float*) malloc(sizeof(*cl) * NP_MAX * siz);
+    int i, j, k, n, j0;
+
+    useClimates(bn, ((1U << NP_MAX) - 1) & ~(1U << NP_SHIFT));
+
+    for (j0 = 0; j0 < r.sz; j0 += band)
+    {
+        int bh = r.sz - j0 < band ? r.sz - j0 : band;
+        double x0 = (double) r.x * scale + mid;
+        double z0 = (double) (r.z + j0) * scale + mid;
+        for (n = 0; n < (int) (sizeof(np_id) / sizeof(*np_id)); n++)
+        {
+            sampleDoublePerlinGrid(&bn->climate[np_id[n]], buf, x0, 0, z0,
+                scale, scale, r.sx, bh);
+            for (i = 0; i < r.sx * bh; i++)
+                cl[i*NP_MAX + np_id[n]] = (float) buf[i];
+        }
+        for (i = 0; i < r.sx * bh; i++)
+            cl[i*NP_MAX + NP_DEPTH] = getColumnOffset(bn, cl + i*NP_MAX);
+
+        for (k = 0; k < r.sy; k++)
+        {
+            int *p = out + (size_t)k*r.sx*r.sz + (size_t)j0*r.sx;
+            for (j = 0; j < bh; j++)
+            {
+                for (i = 0; i < r.sx; i++)
+                {
+                    const float *v = cl + ((size_t)j*r.sx + i) * NP_MAX;
+                    *p++ = climateColumnToBiome(bn, NULL, v, r.y+k, dat,
+                        SAMPLE_NO_SHIFT);
+                }
+            }
+        }
+    }
+
+    free(cl);
+    free(buf);
+}
+
+/* Generates a range with the climates sampled at float32 precision
+ * (SAMPLE_FLOAT32), which uses the batched samplers along each row.
+ */
+static void genBiomeNoiseRowsF(const BiomeNoise *bn, int *out, Range r,
+    uint64_t *dat, uint32_t flags)
+{
+    static const int np_id[] = {
+        NP_TEMPERATURE, NP_HUMIDITY, NP_CONTINENTALNESS, NP_EROSION,
+        NP_WEIRDNESS,
+    };
+    int scale = r.scale > 4 ? r.scale / 4 : 1;
+    int mid = scale / 2;
+    // Volumes keep the climates of all the columns, so the biomes can be
+    // mapped layer by layer.
+    int rows = r.sy > 1 ? r.sz : 1;
+    double *buf = (double*) malloc(sizeof(*buf) * 4 * r.sx);
+    double *px = buf, *pz = buf + r.sx, *sx = buf + 2*r.sx, *zero = buf + 3*r.sx;
+    float *v = (float*) malloc(sizeof(*v) * r.sx);
+    float *cl = (float*) malloc(sizeof(*cl) * NP_MAX * r.sx * rows);
+    int i, j, k, n;
+
+    if (flags & SAMPLE_NO_SHIFT)
+        useClimates(bn, ((1U << NP_MAX) - 1) & ~(1U << NP_SHIFT));
+    else
+        useClimates(bn, (1U << NP_MAX) - 1);
+
+    for (i = 0; i < r.sx; i++)
+        zero[i] = 0;
+
+    for (j = 0; j < r.sz; j++)
+    {
+        float *c = cl + (size_t)(rows > 1 ? j : 0) * r.sx * NP_MAX;
+        for (i = 0; i < r.sx; i++)
+        {
+            px[i] = (r.x+i)*scale + mid;
+            pz[i] = (r.z+j)*scale + mid;
+        }
+        if (!(flags & SAMPLE_NO_SHIFT))
+        {   // both shifts are sampled at the undistorted position
+            const DoublePerlinNoise *shift = &bn->climate[NP_SHIFT];
+            sampleDoublePerlinBatchF(shift, v, px, zero, pz, r.sx);
+            for (i = 0; i < r.sx; i++)
+                sx[i] = px[i] + v[i] * 4.0;
+            sampleDoublePerlinBatchF(shift, v, pz, px, zero, r.sx);
+            for (i = 0; i < r.sx; i++)
+            {
+                pz[i] += v[i] * 4.0;
+                px[i] = sx[i];
+            }
+        }
+        for (n = 0; n < (int) (sizeof(np_id) / sizeof(*np_id)); n++)
+        {
+            sampleDoublePerlinBatchF(&bn->climate[np_id[n]], v, px, zero, pz,
+                r.sx);
+            for (i = 0; i < r.sx; i++)
+                c[i*NP_MAX + np_id[n]] = v[i];
+        }
+        for (i = 0; i < r.sx; i++)
+        {
+            c[i*NP_MAX + NP_DEPTH] = 0;
+            if (!(flags & SAMPLE_NO_DEPTH))
+                c[i*NP_MAX + NP_DEPTH] = getColumnOffset(bn, c + i*NP_MAX);
+        }
+        if (rows > 1)
+            continue;
+        for (i = 0; i < r.sx; i++)
+            out[(size_t)j*r.sx + i] =
+                climateColumnToBiome(bn, NULL, c + i*NP_MAX, r.y, dat, flags);
+    }
+
+    int *p = out;
+    for (k = 0; rows > 1 && k < r.sy; k++)
+    {
+        for (i = 0; i < r.sx * r.sz; i++)
+            *p++ = climateColumnToBiome(bn, NULL, cl + (size_t)i*NP_MAX,
+                r.y+k, dat, flags);
+    }
+
+    free(cl);
+    free(v);
+    free(buf);
+}
+
 static void genBiomeNoise3D(const BiomeNoise *bn, int *out, Range r, int opt)
 {
     uint64_t dat = 0;
     uint64_t *p_dat = opt ? &dat : NULL;
     uint32_t flags = opt ? SAMPLE_NO_SHIFT : 0;
+    if (bn->f32)
+        flags |= SAMPLE_FLOAT32;
     int i, j, k;
     int *p = out;
     int scale = r.scale > 4 ? r.scale / 4 : 1;
     int mid = scale / 2;
+
+    if (bn->nptype < 0 && (flags & SAMPLE_NO_SHIFT))
+    {
+        genBiomeNoiseGrid(bn, out, r, p_dat);
+        return;
+    }
+    if (bn->nptype < 0 && (flags & SAMPLE_FLOAT32))
+    {
+        genBiomeNoiseRowsF(bn, out, r, p_dat, flags);
+        return;
+    }
+    if (bn->nptype < 0 && r.sy > 1 && !p_dat)
+    {   // Without the 'dat' hint the mapping order is irrelevant and we can
+        // sample the climates once per column.
+        size_t area = (size_t)r.sx * r.sz;
+        for (j = 0; j < r.sz; j++)
+        {
+            int zj = (r.z+j)*scale + mid;
+            for (i = 0; i < r.sx; i++)
+            {
+                int xi = (r.x+i)*scale + mid;
+                float cl[NP_MAX];
+                sampleClimateColumn(bn, cl, xi, zj, flags);
+                p = out + (size_t)j*r.sx + i;
+                for (k = 0; k < r.sy; k++, p += area)
+                    *p = climateColumnToBiome(bn, NULL, cl, r.y+k, NULL, flags);
+            }
+        }
+        return;
+    }
+
     for (k = 0; k < r.sy; k++)
     {
         int yk = (r.y+k);
@@ -1623,7 +2207,8 @@ int genBiomeNoiseScaled(const BiomeNoise *bn, int *out, Range r, uint64_t sha)
                     }
                     else
                     {
-                        *p = sampleBiomeNoise(bn, 0, x4, y4, z4, 0, 0);
+                        *p = sampleBiomeNoise(bn, 0, x4, y4, z4, 0,
+                            bn->f32 ? SAMPLE_FLOAT32 : 0);
                     }
                     p++;
                 }
@@ -1757,8 +2342,8 @@ int genBiomeNoiseBetaScaled(const BiomeNoiseBeta *bnb,
     int cellwidth = r.scale >> 1;
     int cx1 = r.x >> (2 >> cellwidth);
     int cz1 = r.z >> (2 >> cellwidth);
-    int cx2 = cx1 + (r.sx >> (2 >> cellwidth)) + 1;
-    int cz2 = cz1 + (r.sz >> (2 >> cellwidth)) + 1;
+    int cx2 = ((r.x + r.sx - 1) >> (2 >> cellwidth)) + 1;
+    int cz2 = ((r.z + r.sz - 1) >> (2 >> cellwidth)) + 1;
     int steps = 4 >> cellwidth;
     int minDim, maxDim;
     if (cx2-cx1 > cz2-cz1) {
@@ -134,6 +134,11 @@ STRUCT(BiomeNoise)
     SplineStack ss;
     int nptype;
     int mc;
+    // lazy seeding (see setBiomeSeedLazy())
+    uint64_t xlo, xhi;
+    int large;
+    uint32_t lazy; // climates that are not initialized yet (1 << NP_*)
+    int f32; // generate areas with SAMPLE_FLOAT32 in genBiomeNoiseScaled()
 };
 // Overworld biome generator for pre-Beta 1.8
 STRUCT(BiomeNoiseBeta)
@@ -240,12 +245,39 @@ enum {
     SAMPLE_NO_SHIFT = 0x1,  // skip local distortions
     SAMPLE_NO_DEPTH = 0x2,  // skip depth sampling for vertical biomes
     SAMPLE_NO_BIOME = 0x4,  // do not apply climate noise to biome mapping
+    SAMPLE_FLOAT32  = 0x8,  // sample the climates at float32 precision
 };
 void initBiomeNoise(BiomeNoise *bn, int mc);
 void setBiomeSeed(BiomeNoise *bn, uint64_t seed, int large);
+/**
+ * Lazy variant of setBiomeSeed(), which defers the initialization of the
+ * climate octaves, such that each climate is only initialized once it is
+ * sampled. This avoids most of the seeding cost for seeds that are rejected
+ * after looking at a few climates, or at none. Like an attached cache, the
+ * sampling then updates the BiomeNoise, so it should not be shared between
+ * threads until the climates have been initialized.
+ * initClimates() initializes the climates in 'npmask' (bits 1 << NP_*) right
+ * away, which should be done before the climate noises are used directly.
+ */
+void setBiomeSeedLazy(BiomeNoise *bn, uint64_t seed, int large);
+void initClimates(BiomeNoise *bn, uint32_t npmask);
 void setBetaBiomeSeed(BiomeNoiseBeta *bnb, uint64_t seed);
 int sampleBiomeNoise(const BiomeNoise *bn, int64_t *np, int x, int y, int z,
     uint64_t *dat, uint32_t sample_flags);
+/**
+ * Progressive variant of sampleBiomeNoise() that checks the noise parameters
+ * at a position against the limits 'lim', given as min/max pairs in the order
+ * of getBiomeParaLimits(). The octaves of each climate are sampled in order of
+ * decreasing amplitude only until its parameter is provably inside or outside
+ * of the limits (see refineDoublePerlin()), which for most positions happens
+ * after the first few octaves. Climates without limits are not sampled, while
+ * limits on the depth require the full continentalness, erosion and weirdness.
+ * The BiomeNoise should be seeded with setBiomeSeed() or setBiomeSeedLazy().
+ * Returns 1 if all parameters are within the limits, and 0 if any is outside,
+ * in which case the biome of the limits cannot generate at the position.
+ */
+int sampleBiomeNoiseLimits(const BiomeNoise *bn, const int lim[12],
+    int x, int y, int z, uint32_t sample_flags);
 int sampleBiomeNoiseBeta(const BiomeNoiseBeta *bnb, int64_t *np, double *nv,
     int x, int z);
 double approxSurfaceBeta(const BiomeNoiseBeta *bnb, const SurfaceNoiseBeta *snb,
@@ -1431,8 +1431,99 @@ static const uint64_t g_monument_biomes1 =
     (1ULL << warm_ocean) |
     (1ULL << deep_warm_ocean);
 
-int isViableStructurePos(int structureType, Generator *g, int x, int z, uint32_t flags)
+/* Biome lookups of the viability checks. For the layered Overworld (MC B1.8 -
+ * 1.17) the checks run on a layer stack 'ls' in which L_BIOME_256 and
+ * L_SHORE_16 are replaced by the viability layers, which is either the stack
+ * of the generator itself or a private copy in a ViableCtx. Otherwise 'ls' is
+ * NULL and the generator is used directly.
+ */
+STRUCT(ViableEnv)
+{
+    const Generator *g;
+    Layer *ls;
+    int **buf;      // growable buffer for the layered lookups
+    size_t *len;
+};
+
+static const Layer *viableLayer(const ViableEnv *env, const Layer *l)
+{
+    return env->ls + (l - env->g->ls.layers);
+}
+
+static int *getViableBuf(const ViableEnv *env, const Layer *entry, int w, int h)
+{
+    size_t len = getMinLayerCacheSize(entry, w, h);
+    if (len > *env->len)
+    {
+        int *buf = (int*) realloc(*env->buf, len * sizeof(int));
+        if (!buf)
+            return NULL;
+        *env->buf = buf;
+        *env->len = len;
+    }
+    return *env->buf;
+}
+
+/* Gets the biome at a scale of 1 or 4, or at scale zero for the layer 'lid'.
+ */
+static int getViableBiomeAt(const ViableEnv *env, int lid,
+    int scale, int x, int y, int z)
+{
+    if (!env->ls)
+        return getBiomeAt(env->g, scale, x, y, z);
+    const Layer *entry;
+    if (scale == 1)
+        entry = viableLayer(env, env->g->ls.entry_1);
+    else if (scale == 4)
+        entry = viableLayer(env, env->g->ls.entry_4);
+    else if (scale == 0 && lid >= 0)
+        entry = env->ls + lid;
+    else
+        return none;
+    int *ids = getViableBuf(env, entry, 1, 1);
+    if (!ids || genArea(entry, ids, x, z, 1, 1))
+        return none;
+    return ids[0];
+}
+
+static int areBiomesViableEnv(const ViableEnv *env, int x, int y, int z,
+    int rad, uint64_t validB, uint64_t validM, int approx)
+{
+    if (!env->ls)
+        return areBiomesViable(env->g, x, y, z, rad, validB, validM, approx);
+
+    // same as areBiomesViable() for the layered generator
+    int x1 = (x - rad) >> 2, x2 = (x + rad) >> 2, sx = x2 - x1 + 1;
+    int z1 = (z - rad) >> 2, z2 = (z + rad) >> 2, sz = z2 - z1 + 1;
+    int i, id;
+
+    Pos corners[4] = { {x1,z1}, {x2,z2}, {x1,z2}, {x2,z1} };
+    for (i = 0; i < 4; i++)
+    {
+        id = getViableBiomeAt(env, -1, 4, corners[i].x, 0, corners[i].z);
+        if (id < 0 || !id_matches(id, validB, validM))
+            return 0;
+    }
+    if (approx >= 1)
+        return 1;
+
+    const Layer *entry = viableLayer(env, env->g->ls.entry_4);
+    int *ids = getViableBuf(env, entry, sx, sz);
+    if (!ids || genArea(entry, ids, x1, z1, sx, sz))
+        return 0;
+    for (i = 0; i < sx*sz; i++)
+    {
+        if (!id_matches(ids[i], validB, validM))
+            return 0;
+    }
+    return 1;
+}
+
+static int viableStructurePos(const ViableEnv *env, int structureType,
+    int x, int z, uint32_t flags)
 {
+    const Generator *g = env->g;
+    int lid = -1; // layer id of the scaled entry (layered Overworld)
     int approx = 0; // enables approximation levels
     int viable = 0;
 
@@ -1465,7 +1556,7 @@ int isViableStructurePos(int structureType, Generator *g, int x, int z, uint32_t
             };
             if (!getStructurePos(Bastion, g->mc, g->seed, rp.x, rp.z, &rp))
                 return 1;
-            return !isViableStructurePos(Bastion, g, x, z, flags);
+            return !viableStructurePos(env, Bastion, x, z, flags);
         }
         sampleY = 0;
         if (g->mc >= MC_1_18 && structureType == Bastion)
@@ -1507,21 +1598,6 @@ int isViableStructurePos(int structureType, Generator *g, int x, int z, uint32_t
 
     // Overworld
 
-    Layer lbiome, lshore, *entry = 0;
-    int data[2] = { structureType, g->mc };
-
-    if (g->mc <= MC_1_17)
-    {
-        lbiome = g->ls.layers[L_BIOME_256];
-        lshore = g->ls.layers[L_SHORE_16];
-        entry = g->entry;
-
-        g->ls.layers[L_BIOME_256].data = (void*) data;
-        g->ls.layers[L_BIOME_256].getMap = mapViableBiome;
-        g->ls.layers[L_SHORE_16].data = (void*) data;
-        g->ls.layers[L_SHORE_16].getMap = mapViableShore;
-    }
-
     switch (structureType)
     {
     case Trail_Ruins:
@@ -1541,18 +1617,18 @@ int isViableStructurePos(int structureType, Generator *g, int x, int z, uint32_t
 L_feature:
         if (g->mc <= MC_1_15)
         {
-            g->entry = &g->ls.layers[L_VORONOI_1];
+            lid = L_VORONOI_1;
             sampleX = chunkX * 16 + 9;
             sampleZ = chunkZ * 16 + 9;
         }
         else
         {
             if (g->mc <= MC_1_17)
-                g->entry = &g->ls.layers[L_RIVER_MIX_4];
+                lid = L_RIVER_MIX_4;
             sampleX = chunkX * 4 + 2;
             sampleZ = chunkZ * 4 + 2;
         }
-        id = getBiomeAt(g, 0, sampleX, 319>>2, sampleZ);
+        id = getViableBiomeAt(env, lid, 0, sampleX, 319>>2, sampleZ);
         if (id < 0 || !isViableFeatureBiome(g->mc, structureType, id))
             goto L_not_viable;
         goto L_viable;
@@ -1560,18 +1636,18 @@ L_feature:
     case Desert_Well:
         if (g->mc <= MC_1_15)
         {
-            g->entry = &g->ls.layers[L_VORONOI_1];
+            lid = L_VORONOI_1;
             sampleX = x;
             sampleZ = z;
         }
         else
         {
             if (g->mc <= MC_1_17)
-                g->entry = &g->ls.layers[L_RIVER_MIX_4];
+                lid = L_RIVER_MIX_4;
             sampleX = x >> 2;
             sampleZ = z >> 2;
         }
-        id = getBiomeAt(g, 0, sampleX, 319>>2, sampleZ);
+        id = getViableBiomeAt(env, lid, 0, sampleX, 319>>2, sampleZ);
         if (id < 0 || !isViableFeatureBiome(g->mc, structureType, id))
             goto L_not_viable;
         goto L_viable;
@@ -1582,17 +1658,17 @@ L_feature:
             if (g->mc == MC_1_15)
             {   // exclusively in MC_1_15, villages used the same biome check
                 // as other structures
-                g->entry = &g->ls.layers[L_VORONOI_1];
+                lid = L_VORONOI_1;
                 sampleX = chunkX * 16 + 9;
                 sampleZ = chunkZ * 16 + 9;
             }
             else
             {
-                g->entry = &g->ls.layers[L_RIVER_MIX_4];
+                lid = L_RIVER_MIX_4;
                 sampleX = chunkX * 4 + 2;
                 sampleZ = chunkZ * 4 + 2;
             }
-            id = getBiomeAt(g, 0, sampleX, 0, sampleZ);
+            id = getViableBiomeAt(env, lid, 0, sampleX, 0, sampleZ);
             if (id < 0 || !isViableFeatureBiome(g->mc, structureType, id))
                 goto L_not_viable;
             if (flags && (uint32_t) id != flags)
@@ -1603,7 +1679,7 @@ L_feature:
                 // check at block (2, 2) in the starting chunk
                 sampleX = chunkX * 16 + 2;
                 sampleZ = chunkZ * 16 + 2;
-                id = getBiomeAt(g, 1, sampleX, 0, sampleZ);
+                id = getViableBiomeAt(env, lid, 1, sampleX, 0, sampleZ);
                 if (id < 0 || !isViableFeatureBiome(g->mc, structureType, id))
                     goto L_not_viable;
             }
@@ -1622,7 +1698,7 @@ L_feature:
                 sampleX = (chunkX*32 + 2*sv.x + sv.sx-1) / 2 >> 2;
                 sampleZ = (chunkZ*32 + 2*sv.z + sv.sz-1) / 2 >> 2;
                 sampleY = 319 >> 2;
-                id = getBiomeAt(g, 0, sampleX, sampleY, sampleZ);
+                id = getViableBiomeAt(env, lid, 0, sampleX, sampleY, sampleZ);
                 if (id == vv[i] || (id == meadow && vv[i] == plains)) {
                     viable = vv[i];
                     goto L_viable;
@@ -1660,7 +1736,7 @@ L_feature:
                 {
                     if (g->mc >= MC_1_16_1)
                         goto L_not_viable;
-                    if (isViableStructurePos(Village, g, p.x, p.z, 0))
+                    if (viableStructurePos(env, Village, p.x, p.z, 0))
                         goto L_not_viable;
                 }
             }
@@ -1680,17 +1756,17 @@ L_feature:
         }
         else if (g->mc >= MC_1_16_1)
         {
-            g->entry = &g->ls.layers[L_RIVER_MIX_4];
+            lid = L_RIVER_MIX_4;
             sampleX = chunkX * 4 + 2;
             sampleZ = chunkZ * 4 + 2;
         }
         else
         {
-            g->entry = &g->ls.layers[L_VORONOI_1];
+            lid = L_VORONOI_1;
             sampleX = chunkX * 16 + 9;
             sampleZ = chunkZ * 16 + 9;
         }
-        id = getBiomeAt(g, 0, sampleX, 319>>2, sampleZ);
+        id = getViableBiomeAt(env, lid, 0, sampleX, 319>>2, sampleZ);
         if (id < 0 || !isViableFeatureBiome(g->mc, structureType, id))
             goto L_not_viable;
         goto L_viable;
@@ -1701,15 +1777,15 @@ L_feature:
             goto L_not_viable;
         else if (g->mc == MC_1_8)
         {   // In 1.8 monuments require only a single deep ocean block.
-            id = getBiomeAt(g, 1, chunkX * 16 + 8, 0, chunkZ * 16 + 8);
+            id = getViableBiomeAt(env, lid, 1, chunkX * 16 + 8, 0, chunkZ * 16 + 8);
             if (id < 0 || !isDeepOcean(id))
                 goto L_not_viable;
         }
         else if (g->mc <= MC_1_17)
         {   // Monuments require two viability checks with the ocean layer
             // branch => worth checking for potential deep ocean beforehand.
-            g->entry = &g->ls.layers[L_SHORE_16];
-            id = getBiomeAt(g, 0, chunkX, 0, chunkZ);
+            lid = L_SHORE_16;
+            id = getViableBiomeAt(env, lid, 0, chunkX, 0, chunkZ);
             if (id < 0 || !isDeepOcean(id))
                 goto L_not_viable;
         }
@@ -1717,16 +1793,16 @@ L_feature:
         sampleZ = chunkZ * 16 + 8;
         if (g->mc >= MC_1_9 && g->mc <= MC_1_17)
         {   // check for deep ocean center
-            if (!areBiomesViable(g, sampleX, 63, sampleZ, 16, g_monument_biomes2, 0, approx))
+            if (!areBiomesViableEnv(env, sampleX, 63, sampleZ, 16, g_monument_biomes2, 0, approx))
                 goto L_not_viable;
         }
         else if (g->mc >= MC_1_18)
         {   // check is done at y level of ocean floor - approx. with y = 36
-            id = getBiomeAt(g, 4, sampleX>>2, 36>>2, sampleZ>>2);
+            id = getViableBiomeAt(env, lid, 4, sampleX>>2, 36>>2, sampleZ>>2);
             if (!isDeepOcean(id))
                 goto L_not_viable;
         }
-        if (areBiomesViable(g, sampleX, 63, sampleZ, 29, g_monument_biomes1, 0, approx))
+        if (areBiomesViableEnv(env, sampleX, 63, sampleZ, 29, g_monument_biomes1, 0, approx))
             goto L_viable;
         goto L_not_viable;
 
@@ -1739,7 +1815,7 @@ L_feature:
             sampleZ = chunkZ * 16 + 8;
             uint64_t b = (1ULL << dark_forest);
             uint64_t m = (1ULL << (dark_forest_hills-128));
-            if (!areBiomesViable(g, sampleX, 0, sampleZ, 32, b, m, approx))
+            if (!areBiomesViableEnv(env, sampleX, 0, sampleZ, 32, b, m, approx))
                 goto L_not_viable;
         }
         else
@@ -1750,7 +1826,7 @@ L_feature:
             // TODO: get surface height
             sampleX = chunkX * 16 + 7;
             sampleZ = chunkZ * 16 + 7;
-            id = getBiomeAt(g, 4, sampleX>>2, 319>>2, sampleZ>>2);
+            id = getViableBiomeAt(env, lid, 4, sampleX>>2, 319>>2, sampleZ>>2);
             if (id < 0 || !isViableFeatureBiome(g->mc, structureType, id))
                 goto L_not_viable;
         }
@@ -1780,7 +1856,7 @@ L_jigsaw:
             sampleX = (chunkX*32 + 2*sv.x + sv.sx - 1) / 2 >> 2;
             sampleZ = (chunkZ*32 + 2*sv.z + sv.sz - 1) / 2 >> 2;
             sampleY = sv.y >> 2;
-            id = getBiomeAt(g, 4, sampleX, sampleY, sampleZ);
+            id = getViableBiomeAt(env, lid, 4, sampleX, sampleY, sampleZ);
         }
         if (id < 0 || !isViableFeatureBiome(g->mc, structureType, id))
             goto L_not_viable;
@@ -1800,13 +1876,89 @@ L_viable:
     if (!viable)
         viable = 1;
 L_not_viable:
-    if (g->mc <= MC_1_17)
+    return viable;
+}
+
+static int isLayeredOverworld(const Generator *g)
+{
+    return g->dim == DIM_OVERWORLD && g->mc >= MC_B1_8 && g->mc <= MC_1_17;
+}
+
+int isViableStructurePos(int structureType, Generator *g, int x, int z, uint32_t flags)
+{
+    // the viability layers are swapped into a copy of the layer stack, which
+    // also bypasses any attached TileCache
+    ViableCtx vc;
+    initViableCtx(&vc);
+    int viable = isViableStructurePosCtx(structureType, g, &vc, x, z, flags);
+    freeViableCtx(&vc);
+    return viable;
+}
+
+void initViableCtx(ViableCtx *vc)
+{
+    memset(vc, 0, sizeof(*vc));
+}
+
+void freeViableCtx(ViableCtx *vc)
+{
+    free(vc->buf);
+    initViableCtx(vc);
+}
+
+/* Copies the layer stack of the generator into the context, relinking the
+ * parents to the copy, detaching any TileCache and inserting the viability
+ * layers.
+ */
+static void copyViableLayers(ViableCtx *vc, const Generator *g)
+{
+    const Layer *l0 = g->ls.layers, *l1 = l0 + L_NUM;
+    int i;
+
+    memcpy(vc->layers, l0, sizeof(vc->layers));
+    for (i = 0; i < L_NUM; i++)
     {
-        g->ls.layers[L_BIOME_256] = lbiome;
-        g->ls.layers[L_SHORE_16] = lshore;
-        g->entry = entry;
+        Layer *l = vc->layers + i;
+        if (l->p >= l0 && l->p < l1)
+            l->p = vc->layers + (l->p - l0);
+        if (l->p2 >= l0 && l->p2 < l1)
+            l->p2 = vc->layers + (l->p2 - l0);
+        if (l->getMap == mapTileCached)
+        {
+            l->getMap = ((const TileLayer*) l->data)->map;
+            l->data = NULL;
+        }
     }
-    return viable;
+    vc->layers[L_BIOME_256].data = (void*) vc->data;
+    vc->layers[L_BIOME_256].getMap = mapViableBiome;
+    vc->layers[L_SHORE_16].data = (void*) vc->data;
+    vc->layers[L_SHORE_16].getMap = mapViableShore;
+
+    vc->g = g;
+    vc->mc = g->mc;
+    vc->flags = g->flags;
+    vc->seed = g->seed;
+}
+
+int isViableStructurePosCtx(int structureType, const Generator *g,
+    ViableCtx *vc, int x, int z, uint32_t flags)
+{
+    ViableEnv env = { g, NULL, NULL, NULL };
+    if (!isLayeredOverworld(g))
+        return viableStructurePos(&env, structureType, x, z, flags);
+
+    if (vc->g != g || vc->mc != g->mc || vc->flags != g->flags ||
+        vc->seed != g->seed)
+    {
+        copyViableLayers(vc, g);
+    }
+    vc->data[0] = structureType;
+    vc->data[1] = g->mc;
+
+    env.ls = vc->layers;
+    env.buf = &vc->buf;
+    env.len = &vc->len;
+    return viableStructurePos(&env, structureType, x, z, flags);
 }
 
 
@@ -3715,6 +3867,7 @@ int checkForBiomes(
         // of finding the biomes with exteme climates early.
         double tmin, tmax;
         int err = 0;
+        initClimates(&g->bn, (1U << NP_MAX) - 1);
         do
         {
             err = getParaRange(&g->bn.climate[NP_TEMPERATURE], &tmin, &tmax,
@@ -4276,6 +4429,10 @@ L_has_proto_mushroom:
         }
     }
 
+    // the cached layers would serve their tiles without the filters
+    TileLayer *cached[L_NUM];
+    suspendTileCache(g, cached);
+
     filter_data_t fd[9];
     swapMap(fd+0, filter, l+L_OCEAN_MIX_4,    mapFilterOceanMix);
     swapMap(fd+1, filter, l+L_RIVER_MIX_4,    mapFilterRiverMix);
@@ -4329,6 +4486,7 @@ L_has_proto_mushroom:
     restoreMap(fd+2, l+L_SHORE_16);
     restoreMap(fd+1, l+L_RIVER_MIX_4);
     restoreMap(fd+0, l+L_OCEAN_MIX_4);
+    resumeTileCache(g, cached);
 
     if (cache == NULL)
         free(ids);
@@ -4511,6 +4669,7 @@ int getBiomeCenters(Pos *pos, int *siz, int nmax, Generator *g, Range r,
                     const int *plim = lim + 2*para[k];
                     if (plim[0] == INT_MIN && plim[1] == INT_MAX)
                         continue;
+                    initClimates(&g->bn, 1U << para[k]);
                     DoublePerlinNoise *dpn = &g->bn.climate[para[k]];
                     double px = (r.x+i) * r.scale / 4.0;
                     double pz = (r.z+j) * r.scale / 4.0;
@@ -107,6 +107,23 @@ STRUCT(EndIsland)
     int r;
 };
 
+/* Scratch context for isViableStructurePosCtx(), which lets threads share one
+ * generator. For the layered Overworld (MC B1.8 - 1.17) it holds a private copy
+ * of the layer stack with the viability layers, which is renewed whenever the
+ * context is used with a different generator, version, flags or seed.
+ */
+STRUCT(ViableCtx)
+{
+    const Generator *g; // generator of the copied layers
+    int mc;
+    uint32_t flags;
+    uint64_t seed;
+    int data[2];        // structure type and version for the viability layers
+    int *buf;           // buffer for the biome lookups
+    size_t len;
+    Layer layers[L_NUM];
+};
+
 enum
 {
     BF_APPROX       = 0x01, // enabled aggresive filtering, trading accuracy
@@ -349,13 +366,26 @@ static inline uint64_t getShadow(uint64_t seed)
  * whether a structure of the given type could spawn there. You can get the
  * block positions using getStructurePos().
  * The generator, 'g', should be initialized for the correct MC version,
- * dimension and seed. The generator may be temporarily modified during the
- * function call, but will be restored upon return.
+ * dimension and seed. The check runs on a copy of the layer stack (see
+ * isViableStructurePosCtx()), so the generator is not modified and an
+ * attached TileCache is bypassed.
  * The 'flags' argument is optional structure specific information, such as the
  * biome variant for villages.
  */
 int isViableStructurePos(int structType, Generator *g, int blockX, int blockZ, uint32_t flags);
 
+/* Same as isViableStructurePos(), but leaves the generator unmodified, so that
+ * multiple threads can check structures with the same generator, as long as
+ * each uses its own context 'vc'. (An attached TileCache is not used by the
+ * checks.)
+ * A context is initialized with initViableCtx() and its buffer is released
+ * with freeViableCtx().
+ */
+void initViableCtx(ViableCtx *vc);
+void freeViableCtx(ViableCtx *vc);
+int isViableStructurePosCtx(int structType, const Generator *g, ViableCtx *vc,
+        int blockX, int blockZ, uint32_t flags);
+
 /* Checks if the specified structure type could generate in the given biome.
  */
 int isViableFeatureBiome(int mc, int structureType, int biomeID);
@@ -90,6 +90,7 @@ void setupGenerator(Generator *g, int mc, uint32_t flags)
     else if (mc >= MC_1_18)
     {
         initBiomeNoise(&g->bn, mc);
+        g->bn.f32 = !!(flags & FLOAT32_NOISE);
     }
     else
     {
@@ -116,7 +117,10 @@ void applySeed(Generator *g, int dim, uint64_t seed)
         }
         else // if (g->mc >= MC_1_18)
         {
-            setBiomeSeed(&g->bn, seed, g->flags & LARGE_BIOMES);
+            if (g->flags & LAZY_CLIMATES)
+                setBiomeSeedLazy(&g->bn, seed, g->flags & LARGE_BIOMES);
+            else
+                setBiomeSeed(&g->bn, seed, g->flags & LARGE_BIOMES);
         }
     }
     else if (dim == DIM_NETHER && g->mc >= MC_1_16_1)
@@ -136,6 +140,35 @@ void applySeed(Generator *g, int dim, uint64_t seed)
     }
 }
 
+int setTileCache(Generator *g, TileCache *tc)
+{
+    if (g->mc < MC_B1_8 || g->mc > MC_1_17)
+        return tc != NULL;
+
+    int i;
+    for (i = 0; i < L_NUM; i++)
+        detachTileCache(&g->ls.layers[i]);
+    for (i = 0; i < 5; i++)
+        detachTileCache(&g->xlayer[i]);
+    if (tc == NULL)
+        return 0;
+
+    Layer *entries[] = { g->ls.entry_256, g->ls.entry_64 };
+    for (i = 0; i < 2; i++)
+    {
+        Layer *l = entries[i];
+        // ocean variants are mixed in outside of the seeded layer stack
+        while (l && l->getMap == mapOceanMixMod)
+            l = l->p;
+        if (l && attachTileCache(tc, l) != 0)
+            return 1;
+    }
+    // the cached layers are keyed by the current world seed
+    if (g->dim == DIM_OVERWORLD)
+        setLayerSeed(g->entry ? g->entry : g->ls.entry_1, g->seed);
+    return 0;
+}
+
 
 size_t getMinCacheSize(const Generator *g, int scale, int sx, int sy, int sz)
 {
@@ -146,7 +179,7 @@ size_t getMinCacheSize(const Generator *g, int scale, int sx, int sy, int sz)
     {
         int cellwidth = scale >> 1;
         int smin = (sx < sz ? sx : sz);
-        int slen = ((smin >> (2 >> cellwidth)) + 1) * 2 + 1;
+        int slen = ((smin >> (2 >> cellwidth)) + 2) * 2 + 1;
         len += slen * sizeof(SeaLevelColumnNoiseBeta);
     }
     else if (g->mc >= MC_B1_8 && g->mc <= MC_1_17 && g->dim == DIM_OVERWORLD)
@@ -235,6 +268,400 @@ int genBiomes(const Generator *g, int *cache, Range r)
     return err;
 }
 
+int genBiomesTiled(const Generator *g, Range r, int tw, int th,
+    int (*fn)(void *data, Range tile, const int *ids), void *data)
+{
+    if (tw <= 0 || th <= 0)
+        return 1;
+    if (tw > r.sx) tw = r.sx;
+    if (th > r.sz) th = r.sz;
+    if (tw <= 0 || th <= 0)
+        return 0;
+
+    size_t len = getMinCacheSize(g, r.scale, tw, r.sy, th);
+    if (len == 0)
+        return 1;
+    int *cache = (int*) calloc(len, sizeof(int));
+    if (!cache)
+        return 1;
+
+    int err = 0;
+    int64_t i, j;
+    for (j = 0; j < r.sz && !err; j += th)
+    {
+        for (i = 0; i < r.sx && !err; i += tw)
+        {
+            Range t = r;
+            t.x = (int)(r.x + i);
+            t.z = (int)(r.z + j);
+            t.sx = (int)(r.sx - i < tw ? r.sx - i : tw);
+            t.sz = (int)(r.sz - j < th ? r.sz - j : th);
+            err = genBiomes(g, cache, t);
+            if (!err)
+                err = fn(data, t, cache);
+        }
+    }
+
+    free(cache);
+    return err;
+}
+
+STRUCT(ParallelGen)
+{
+    const Generator *g;
+    int **bufs;         // per worker tile buffers
+    int *out;
+    Range r;
+    int tw, th, tcnt;
+};
+
+static int genTileTask(void *data, int task, int worker)
+{
+    ParallelGen *pg = (ParallelGen*) data;
+    const Generator *g = pg->g;
+    Range r = pg->r;
+    Range t = r;
+    int64_t tx = (int64_t)(task % pg->tcnt) * pg->tw;
+    int64_t tz = (int64_t)(task / pg->tcnt) * pg->th;
+    t.x = (int)(r.x + tx);
+    t.z = (int)(r.z + tz);
+    t.sx = (int)(r.sx - tx < pg->tw ? r.sx - tx : pg->tw);
+    t.sz = (int)(r.sz - tz < pg->th ? r.sz - tz : pg->th);
+
+    int *buf = pg->bufs[worker];
+    int err = genBiomes(g, buf, t);
+    if (err)
+        return err;
+
+    int64_t j, k, sy = r.sy > 0 ? r.sy : 1;
+    for (k = 0; k < sy; k++)
+    {
+        for (j = 0; j < t.sz; j++)
+        {
+            memcpy(pg->out + (k * r.sz + tz + j) * r.sx + tx,
+                buf + (k * t.sz + j) * t.sx, t.sx * sizeof(int));
+        }
+    }
+    return 0;
+}
+
+static int hasTileCache(const Layer *l)
+{
+    if (l == NULL)
+        return 0;
+    if (l->getMap == mapTileCached)
+        return 1;
+    return hasTileCache(l->p) || hasTileCache(l->p2);
+}
+
+int genBiomesParallel(const Generator *g, int *cache, Range r, ThreadPool *pool)
+{
+    int threads = pool ? getThreadCount(pool) : 1;
+    if (threads <= 1 || (int64_t)r.sx * r.sz < 2 * 256)
+        return genBiomes(g, cache, r);
+    // generations that depend on the range are not split into tiles
+    if ((g->mc >= MC_1_18 && r.scale > 4) || (g->dim == DIM_NETHER && r.sy > 1))
+        return genBiomes(g, cache, r);
+
+    if (g->dim == DIM_OVERWORLD && g->mc >= MC_B1_8 && g->mc <= MC_1_17)
+    {
+        const Layer *entry = getLayerForScale(g, r.scale);
+        if (!entry) return -1;
+        if (hasTileCache(entry))
+            return genBiomes(g, cache, r);
+    }
+
+    // aim for a few tiles per worker to balance the load, while keeping the
+    // tiles large enough that their borders are a small overhead
+    int64_t area = (int64_t)r.sx * r.sz;
+    int64_t target = area / (4 * threads);
+    if (target < 256)
+        target = 256;
+    int64_t side = (int64_t) sqrt((double) target);
+    int64_t tw = side, th;
+    if (tw * r.sz < target)
+        tw = (target + r.sz - 1) / r.sz;
+    if (tw > r.sx)
+        tw = r.sx;
+    th = (target + tw - 1) / tw;
+    if (th > r.sz)
+        th = r.sz;
+
+    ParallelGen pg;
+    memset(&pg, 0, sizeof(pg));
+    pg.g = g;
+    pg.out = cache;
+    pg.r = r;
+    pg.tw = (int) tw;
+    pg.th = (int) th;
+    pg.tcnt = (int)((r.sx + tw - 1) / tw);
+    int tasks = pg.tcnt * (int)((r.sz + th - 1) / th);
+
+    int err = 1, t;
+    size_t len = getMinCacheSize(g, r.scale, pg.tw, r.sy, pg.th);
+    pg.bufs = (int**) calloc(threads, sizeof(int*));
+    if (!pg.bufs || len == 0)
+        goto L_end;
+    for (t = 0; t < threads; t++)
+    {
+        pg.bufs[t] = (int*) malloc(len * sizeof(int));
+        if (!pg.bufs[t])
+            goto L_end;
+    }
+    if (g->dim == DIM_OVERWORLD && g->mc >= MC_1_18 && g->bn.lazy)
+    {   // the workers must not initialize the shared climates concurrently
+        initClimates((BiomeNoise*) &g->bn, (1U << NP_MAX) - 1);
+    }
+
+    err = runThreadPool(pool, tasks, genTileTask, &pg);
+
+L_end:
+    if (pg.bufs)
+    {
+        for (t = 0; t < threads; t++)
+            free(pg.bufs[t]);
+        free(pg.bufs);
+    }
+    return err;
+}
+
+static inline int floorMod(int a, int m)
+{
+    a %= m;
+    return a < 0 ? a + m : a;
+}
+
+int initViewport(BiomeViewport *vp, Range r)
+{
+    memset(vp, 0, sizeof(*vp));
+    if (r.sx <= 0 || r.sz <= 0)
+        return 1;
+    if (r.sy <= 0)
+        r.sy = 1;
+    vp->r = r;
+    vp->ids = (int*) malloc((size_t)r.sx * r.sz * r.sy * sizeof(int));
+    return vp->ids == NULL;
+}
+
+void freeViewport(BiomeViewport *vp)
+{
+    free(vp->ids);
+    free(vp->cache);
+    memset(vp, 0, sizeof(*vp));
+}
+
+/* Generates the cells [x,z,w,h] of the viewport into their ring positions. */
+static int genViewportRect(BiomeViewport *vp, const Generator *g,
+    int x, int z, int w, int h)
+{
+    Range r = vp->r;
+    Range t = r;
+    t.x = x;
+    t.z = z;
+    t.sx = w;
+    t.sz = h;
+
+    size_t len = getMinCacheSize(g, r.scale, w, r.sy, h);
+    if (len == 0)
+        return 1;
+    if (len > vp->cachelen)
+    {
+        int *buf = (int*) realloc(vp->cache, len * sizeof(int));
+        if (!buf)
+            return 1;
+        vp->cache = buf;
+        vp->cachelen = len;
+    }
+    int err = genBiomes(g, vp->cache, t);
+    if (err)
+        return err;
+    vp->generated += (uint64_t)w * h * r.sy;
+
+    // rows of the strip wrap around at most once in each direction
+    int i0 = floorMod(x, r.sx);
+    int n0 = r.sx - i0 < w ? r.sx - i0 : w;
+    int64_t j, k;
+    for (k = 0; k < r.sy; k++)
+    {
+        for (j = 0; j < h; j++)
+        {
+            const int *src = vp->cache + (k * h + j) * w;
+            int *dst = vp->ids + (k * r.sz + floorMod(z + j, r.sz)) * r.sx;
+            memcpy(dst + i0, src, n0 * sizeof(int));
+            memcpy(dst, src + n0, (w - n0) * sizeof(int));
+        }
+    }
+    return 0;
+}
+
+int moveViewport(BiomeViewport *vp, const Generator *g, int x, int z)
+{
+    Range *r = &vp->r;
+    int dx = x - r->x;
+    int dz = z - r->z;
+
+    if (!vp->valid || vp->mc != g->mc || vp->dim != g->dim ||
+        vp->flags != g->flags || vp->seed != g->seed ||
+        abs(dx) >= r->sx || abs(dz) >= r->sz)
+    {
+        vp->valid = 0;
+        r->x = x;
+        r->z = z;
+        int err = genViewportRect(vp, g, x, z, r->sx, r->sz);
+        if (err)
+            return err;
+        vp->valid = 1;
+        vp->mc = g->mc;
+        vp->dim = g->dim;
+        vp->flags = g->flags;
+        vp->seed = g->seed;
+        return 0;
+    }
+
+    int ox = r->x, oz = r->z;
+    int err = 0;
+    r->x = x;
+    r->z = z;
+    // exposed columns over the full height, then the exposed rows between them
+    if (dx > 0)
+        err = genViewportRect(vp, g, ox + r->sx, z, dx, r->sz);
+    else if (dx < 0)
+        err = genViewportRect(vp, g, x, z, -dx, r->sz);
+    if (err)
+        goto L_err;
+
+    int xr = dx > 0 ? x : ox;
+    int wr = r->sx - abs(dx);
+    if (dz > 0)
+        err = genViewportRect(vp, g, xr, oz + r->sz, wr, dz);
+    else if (dz < 0)
+        err = genViewportRect(vp, g, xr, z, wr, -dz);
+    if (err)
+        goto L_err;
+    return 0;
+
+L_err:
+    vp->valid = 0;
+    return err;
+}
+
+void copyViewport(const BiomeViewport *vp, int *out)
+{
+    const Range *r = &vp->r;
+    int i0 = floorMod(r->x, r->sx);
+    int64_t j, k;
+    for (k = 0; k < r->sy; k++)
+    {
+        for (j = 0; j < r->sz; j++)
+        {
+            const int *src = vp->ids + (k * r->sz + floorMod(r->z + j, r->sz)) * r->sx;
+            int *dst = out + (k * r->sz + j) * r->sx;
+            memcpy(dst, src + i0, (r->sx - i0) * sizeof(int));
+            memcpy(dst + (r->sx - i0), src, i0 * sizeof(int));
+        }
+    }
+}
+
+int getViewportBiome(const BiomeViewport *vp, int x, int y, int z)
+{
+    const Range *r = &vp->r;
+    if (!vp->valid || x < r->x || x >= r->x + r->sx || z < r->z ||
+        z >= r->z + r->sz || y < r->y || y >= r->y + r->sy)
+        return none;
+    int64_t k = y - r->y;
+    return vp->ids[(k * r->sz + floorMod(z, r->sz)) * r->sx + floorMod(x, r->sx)];
+}
+
+// Target number of cells per band of a compact generation, such that the int
+// scratch buffer of a band stays within the cache.
+enum { COMPACT_BAND_CELLS = 1 << 18 };
+
+static int getCompactBand(const Generator *g, int scale, int sx, int sy, int sz)
+{
+    if (sy <= 0)
+        sy = 1;
+    // generations that depend on the range are not split into bands
+    if ((g->mc >= MC_1_18 && scale > 4) || (g->dim == DIM_NETHER && sy > 1))
+        return sz;
+    int64_t h = COMPACT_BAND_CELLS / ((int64_t)sx * sy);
+    if (h < 1)
+        h = 1;
+    return h < sz ? (int) h : sz;
+}
+
+size_t getMinCompactCacheSize(const Generator *g, int scale, int sx, int sy, int sz)
+{
+    if (sx <= 0 || sz <= 0)
+        return 0;
+    return getMinCacheSize(g, scale, sx, sy, getCompactBand(g, scale, sx, sy, sz));
+}
+
+static int genBiomesCompact(const Generator *g, void *out, int bytes,
+    int *cache, Range r)
+{
+    if (r.sx <= 0 || r.sz <= 0)
+        return 0;
+    int sy = r.sy > 0 ? r.sy : 1;
+    int bh = getCompactBand(g, r.scale, r.sx, r.sy, r.sz);
+    int *buf = cache;
+    if (!buf)
+    {
+        size_t len = getMinCacheSize(g, r.scale, r.sx, r.sy, bh);
+        if (len == 0)
+            return 1;
+        buf = (int*) malloc(len * sizeof(int));
+        if (!buf)
+            return 1;
+    }
+
+    size_t plane = (size_t)r.sx * r.sz;
+    int err = 0;
+    int64_t j, k;
+    size_t i;
+    for (j = 0; j < r.sz && !err; j += bh)
+    {
+        Range b = r;
+        b.z = (int)(r.z + j);
+        b.sz = (int)(r.sz - j < bh ? r.sz - j : bh);
+        err = genBiomes(g, buf, b);
+        if (err)
+            break;
+        // narrow each layer of the band into its place in the output
+        size_t n = (size_t)r.sx * b.sz;
+        for (k = 0; k < sy; k++)
+        {
+            const int *src = buf + k * n;
+            size_t off = k * plane + j * r.sx;
+            if (bytes == 1)
+            {
+                uint8_t *dst = (uint8_t*) out + off;
+                for (i = 0; i < n; i++)
+                    dst[i] = (uint8_t) src[i];
+            }
+            else
+            {
+                uint16_t *dst = (uint16_t*) out + off;
+                for (i = 0; i < n; i++)
+                    dst[i] = (uint16_t) src[i];
+            }
+        }
+    }
+
+    if (buf != cache)
+        free(buf);
+    return err;
+}
+
+int genBiomesU8(const Generator *g, uint8_t *out, int *cache, Range r)
+{
+    return genBiomesCompact(g, out, 1, cache, r);
+}
+
+int genBiomesU16(const Generator *g, uint16_t *out, int *cache, Range r)
+{
+    return genBiomesCompact(g, out, 2, cache, r);
+}
+
 int getBiomeAt(const Generator *g, int scale, int x, int y, int z)
 {
     Range r = {scale, x, z, 1, 1, y, 1};
@@ -557,49 +984,6 @@ void setupLayerStack(LayerStack *g, int mc, int largeBiomes)
 }
 
 
-/* Recursively calculates the minimum buffer size required to generate an area
- * of the specified size from the current layer onwards.
- */
-static void getMaxArea(
-    const Layer *layer, int areaX, int areaZ, int *maxX, int *maxZ, size_t *siz)
-{
-    if (layer == NULL)
-        return;
-
-    areaX += layer->edge;
-    areaZ += layer->edge;
-
-    // multi-layers and zoom-layers use a temporary copy of their parent area
-    if (layer->p2 || layer->zoom != 1)
-        *siz += areaX * areaZ;
-
-    if (areaX > *maxX) *maxX = areaX;
-    if (areaZ > *maxZ) *maxZ = areaZ;
-
-    if (layer->zoom == 2)
-    {
-        areaX >>= 1;
-        areaZ >>= 1;
-    }
-    else if (layer->zoom == 4)
-    {
-        areaX >>= 2;
-        areaZ >>= 2;
-    }
-
-    getMaxArea(layer->p, areaX, areaZ, maxX, maxZ, siz);
-    if (layer->p2)
-        getMaxArea(layer->p2, areaX, areaZ, maxX, maxZ, siz);
-}
-
-size_t getMinLayerCacheSize(const Layer *layer, int sizeX, int sizeZ)
-{
-    int maxX = sizeX, maxZ = sizeZ;
-    size_t bufsiz = 0;
-    getMaxArea(layer, sizeX, sizeZ, &maxX, &maxZ, &bufsiz);
-    return bufsiz + maxX * (size_t)maxZ;
-}
-
 int genArea(const Layer *layer, int *out, int areaX, int areaZ, int areaWidth, int areaHeight)
 {
     memset(out, 0, sizeof(*out)*areaWidth*areaHeight);
@@ -3,6 +3,7 @@
 
 #include "layers.h"
 #include "biomenoise.h"
+#include "threads.h"
 
 // generator flags
 enum
@@ -10,6 +11,21 @@ enum
     LARGE_BIOMES            = 0x1,
     NO_BETA_OCEAN           = 0x2,
     FORCE_OCEAN_VARIANTS    = 0x4,
+    LAZY_CLIMATES           = 0x8,
+    FLOAT32_NOISE           = 0x10,
+};
+
+STRUCT(BiomeViewport)
+{
+    Range r;            // current range of the viewport
+    int *ids;           // biomes, stored as a ring buffer (see moveViewport())
+    int *cache;         // buffer for generating the exposed strips
+    size_t cachelen;
+    int valid;          // set when 'ids' holds the biomes of 'r'
+    int mc, dim;        // generator state of the biomes
+    uint32_t flags;
+    uint64_t seed;
+    uint64_t generated; // number of generated cells (statistics)
 };
 
 STRUCT(Generator)
@@ -51,7 +67,12 @@ extern "C"
 /**
  * Sets up a biome generator for a given MC version. The 'flags' can be used to
  * control LARGE_BIOMES or to FORCE_OCEAN_VARIANTS to enable ocean variants at
- * scales higher than normal.
+ * scales higher than normal. With LAZY_CLIMATES, applySeed() for the 1.18+
+ * Overworld only initializes the climate noises when they are first sampled
+ * (see setBiomeSeedLazy()), which is cheaper for filters that reject most seeds
+ * after a few samples. FLOAT32_NOISE makes genBiomes() for the 1.18+ Overworld
+ * sample the climates at float32 precision (SAMPLE_FLOAT32), which is faster
+ * but can give a different biome for rare cells that lie on a biome border.
  */
 void setupGenerator(Generator *g, int mc, uint32_t flags);
 
@@ -63,6 +84,18 @@ void setupGenerator(Generator *g, int mc, uint32_t flags);
  */
 void applySeed(Generator *g, int dim, uint64_t seed);
 
+/**
+ * Attaches a TileCache (see initTileCache()) to the 1:256 and 1:64 layers of
+ * the layered generator (MC B1.8 - 1.17), so that they are reused between
+ * overlapping genBiomes() calls for the same seed, or detaches all cached
+ * layers if 'tc' is NULL. The generated biomes are unchanged. The checks that
+ * substitute layers of the stack, i.e. isViableStructurePos() and
+ * checkForBiomes(), bypass the cached layers. While a cache is attached, the
+ * generator should not be used by multiple threads at once.
+ * Returns zero upon success.
+ */
+int setTileCache(Generator *g, TileCache *tc);
+
 /**
  * Calculates the buffer size (number of ints) required to generate a cuboidal
  * volume of size (sx, sy, sz). If 'sy' is zero the buffer is calculated for a
@@ -87,6 +120,93 @@ int *allocCache(const Generator *g, Range r);
  * The return value is zero upon success.
  */
 int genBiomes(const Generator *g, int *cache, Range r);
+/**
+ * Generates a Range 'r' of arbitrary size as a sequence of tiles, each at most
+ * 'tw' by 'th' cells wide and spanning the full vertical range, so that the
+ * memory usage depends only on the tile size. The tiles are passed in row
+ * order (west to east, then north to south) to the callback 'fn' with
+ * their sub-range and biomes, indexed as in genBiomes():
+ *  ids[ y*tile.sx*tile.sz + z*tile.sx + x ]
+ * Each tile generates its own border for the parent layers and the voronoi
+ * source, so the biomes are identical to a single genBiomes() call for all of
+ * 'r'. (The exceptions are 1.18+ scales above 1:4, which use an approximation
+ * that already depends on the range, and some cells of Nether volumes, for
+ * which the optimization of mapNether3D() depends on the range as well.)
+ * Using tw = r.sx yields complete row bands. For the layered versions a
+ * TileCache (see setTileCache()) avoids regenerating the borders that
+ * neighbouring tiles share in the larger scale layers.
+ *
+ * The return value is zero upon success, or the first nonzero value returned
+ * by the generation or the callback, which ends the generation.
+ */
+int genBiomesTiled(const Generator *g, Range r, int tw, int th,
+    int (*fn)(void *data, Range tile, const int *ids), void *data);
+
+/**
+ * Generates the biomes of the Range 'r' like genBiomes(), but splits the range
+ * into tiles (each with its own border for the parent layers and the voronoi
+ * source) that are generated concurrently by the workers of 'pool' (see
+ * createThreadPool()). The output in 'cache' is identical to genBiomes(), and
+ * the buffer needs getMinCacheSize() ints. Since the generator is shared by the
+ * workers, an attached TileCache cannot be used concurrently and such layered
+ * generators run on the calling thread instead. Ranges whose generation
+ * depends on the area (1.18+ scales above 1:4 and Nether volumes) are also
+ * generated on the calling thread.
+ * The return value is zero upon success.
+ */
+int genBiomesParallel(const Generator *g, int *cache, Range r, ThreadPool *pool);
+
+/**
+ * A BiomeViewport holds the biomes of a Range that moves around horizontally,
+ * such as the visible area of a map viewer. moveViewport() shifts the range to
+ * the new north-west corner (x,z) and only generates the newly exposed strips
+ * of cells with genBiomes(), which is exact since each strip generates its own
+ * border for the parent layers and the voronoi source. (The exceptions are
+ * 1.18+ scales above 1:4, as for genBiomesTiled(), and rare cells of Nether
+ * volumes, for which the optimization of mapNether3D() already depends on the
+ * range.) The retained biomes stay in place, with cell (x,y,z) of the range at
+ *  ids[ (y - r.y)*r.sx*r.sz + (z mod r.sz)*r.sx + (x mod r.sx) ]
+ * so the cost of panning depends only on the exposed strips. The whole
+ * range is generated for the first move, for moves that are as large as the
+ * range, and after the version, flags, dimension or seed of the generator
+ * changed. As for genBiomesTiled(), a TileCache avoids regenerating the larger
+ * scale layers that neighbouring strips share.
+ *
+ * copyViewport() writes the biomes of the current range to 'out' in the order
+ * of genBiomes(), and getViewportBiome() gets a single cell inside the range,
+ * or none (-1) outside of it.
+ *
+ * initViewport() and moveViewport() return zero upon success. After a failed
+ * move the viewport is regenerated by the next move.
+ */
+int initViewport(BiomeViewport *vp, Range r);
+void freeViewport(BiomeViewport *vp);
+int moveViewport(BiomeViewport *vp, const Generator *g, int x, int z);
+void copyViewport(const BiomeViewport *vp, int *out);
+int getViewportBiome(const BiomeViewport *vp, int x, int y, int z);
+
+/**
+ * Generates the biomes of the Range 'r' like genBiomes(), but writes them to
+ * 'out' as 8-bit (or 16-bit) ids, with the same indexing:
+ *  out[ y*r.sx*r.sz + z*r.sx + x ]
+ * so the output needs r.sx*r.sz*r.sy elements (with sy=1 for a 2D plane).
+ * The biome ids of all versions fit into a byte, and none (-1) is stored as
+ * 0xff (or 0xffff).
+ *
+ * The int ids are generated in bands of rows that are narrowed into 'out'
+ * one at a time, so the int buffer 'cache' only needs to hold a band and stays
+ * within the processor cache. Its length is given by getMinCompactCacheSize(),
+ * or it can be NULL to allocate one internally. The bands generate their own
+ * borders, as in genBiomesTiled(), and the biomes are identical to genBiomes().
+ * (Ranges whose generation depends on the area, i.e. 1.18+ scales above 1:4
+ * and Nether volumes, are generated at once.)
+ *
+ * The return value is zero upon success.
+ */
+size_t getMinCompactCacheSize(const Generator *g, int scale, int sx, int sy, int sz);
+int genBiomesU8(const Generator *g, uint8_t *out, int *cache, Range r);
+int genBiomesU16(const Generator *g, uint16_t *out, int *cache, Range r);
+
 /**
  * Gets the biome for a specified scaled position. Note that the scale should
  * be either 1 or 4, for block or biome coordinates respectively.
@@ -110,11 +230,6 @@ const Layer *getLayerForScale(const Generator *g, int scale);
 /* Initialize an instance of a layered generator. */
 void setupLayerStack(LayerStack *g, int mc, int largeBiomes);
 
-/* Calculates the minimum size of the buffers required to generate an area of
- * dimensions 'sizeX' by 'sizeZ' at the specified layer.
- */
-size_t getMinLayerCacheSize(const Layer *layer, int sizeX, int sizeZ);
-
 /* Set up custom layers. */
 Layer *setupLayer(Layer *l, mapfunc_t *map, int mc,
     int8_t zoom, int8_t edge, uint64_t saltbase, Layer *p, Layer *p2);
@@ -5,6 +5,14 @@
 #include <math.h>
 #include <float.h>
 
+#if defined(__GNUC__)
+#define LAYER_LANE_VEC 1
+#if defined(__x86_64__) || defined(__i386__)
+#define LAYER_SIMD_X86 1
+#include <immintrin.h>
+#endif
+#endif
+
 
 //==============================================================================
 // Essentials
@@ -46,6 +54,13 @@ void setLayerSeed(Layer *layer, uint64_t worldSeed)
         layer->startSalt = st;
         layer->startSeed = mcStepSeed(st, 0);
     }
+
+    if (layer->getMap == mapTileCached)
+    {   // cached tiles are keyed by the world seed
+        TileLayer *tl = (TileLayer*) layer->data;
+        tl->seed = worldSeed;
+        tl->seeded = 1;
+    }
 }
 
 
@@ -82,6 +97,194 @@ int mapContinent(const Layer * l, int * out, int x, int z, int w, int h)
     return 0;
 }
 
+/* The zoom and smoothing layers only use bits 24 and 25 of their chunk seeds,
+ * which depend on just the lower 32 bits of the PRNG, so the vectorized rows
+ * step the seeds on 32-bit lanes. Cells with four equal neighbours need no
+ * special case, since every choice then yields the same id. The kernels are
+ * bit-exact with the scalar loops and return the number of processed cells.
+ */
+#if LAYER_SIMD_X86
+ATTR(target("avx2"))
+static inline __m256i stepSeedAVX2(__m256i cs, __m256i salt)
+{
+    __m256i t = _mm256_mullo_epi32(cs, _mm256_set1_epi32(1284865837));
+    t = _mm256_add_epi32(t, _mm256_set1_epi32((int)4150755663U));
+    return _mm256_add_epi32(_mm256_mullo_epi32(cs, t), salt);
+}
+
+ATTR(target("avx2"))
+static inline __m256i chooseAVX2(__m256i mask, __m256i a, __m256i b)
+{   // lanes of b where the sign bit of the mask is set, otherwise a
+    return _mm256_blendv_epi8(a, b, _mm256_srai_epi32(mask, 31));
+}
+
+ATTR(target("avx2"))
+static inline __m256i select4AVX2(__m256i cs, __m256i st,
+    __m256i v00, __m256i v01, __m256i v10, __m256i v11)
+{
+    // negated neighbour counts of select4()
+    __m256i c00 = _mm256_add_epi32(_mm256_cmpeq_epi32(v00, v10),
+        _mm256_add_epi32(_mm256_cmpeq_epi32(v00, v01), _mm256_cmpeq_epi32(v00, v11)));
+    __m256i c10 = _mm256_add_epi32(_mm256_cmpeq_epi32(v10, v01),
+        _mm256_cmpeq_epi32(v10, v11));
+    __m256i c01 = _mm256_cmpeq_epi32(v01, v11);
+    __m256i m00 = _mm256_and_si256(_mm256_cmpgt_epi32(c10, c00),
+        _mm256_cmpgt_epi32(c01, c00));
+    __m256i m10 = _mm256_cmpgt_epi32(c00, c10);
+    __m256i m01 = _mm256_cmpgt_epi32(c00, c01);
+
+    cs = stepSeedAVX2(cs, st);
+    __m256i r0 = _mm256_slli_epi32(cs, 7);
+    __m256i r1 = _mm256_slli_epi32(cs, 6);
+    __m256i v = chooseAVX2(r1, chooseAVX2(r0, v00, v10), chooseAVX2(r0, v01, v11));
+    v = _mm256_blendv_epi8(v, v01, m01);
+    v = _mm256_blendv_epi8(v, v10, m10);
+    return _mm256_blendv_epi8(v, v00, m00);
+}
+
+ATTR(target("avx2"))
+static int mapZoomRowAVX2(const int *vz0, const int *vz1, int *b0, int *b1,
+    int n, uint32_t ss, uint32_t st, int cx, int cz, int fuzzy)
+{
+    const __m256i lane = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+    const __m256i vst = _mm256_set1_epi32(st);
+    const __m256i vz = _mm256_set1_epi32(cz);
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        __m256i v00 = _mm256_loadu_si256((const __m256i*) (vz0 + i));
+        __m256i v10 = _mm256_loadu_si256((const __m256i*) (vz0 + i + 1));
+        __m256i v01 = _mm256_loadu_si256((const __m256i*) (vz1 + i));
+        __m256i v11 = _mm256_loadu_si256((const __m256i*) (vz1 + i + 1));
+
+        __m256i vx = _mm256_add_epi32(_mm256_set1_epi32(cx + 2*i), lane);
+        __m256i cs = _mm256_add_epi32(_mm256_set1_epi32(ss), vx);
+        cs = stepSeedAVX2(cs, vz);
+        cs = stepSeedAVX2(cs, vx);
+        cs = stepSeedAVX2(cs, vz);
+        __m256i a01 = chooseAVX2(_mm256_slli_epi32(cs, 7), v00, v01);
+        cs = stepSeedAVX2(cs, vst);
+        __m256i a10 = chooseAVX2(_mm256_slli_epi32(cs, 7), v00, v10);
+        __m256i a11;
+        if (fuzzy)
+        {
+            cs = stepSeedAVX2(cs, vst);
+            __m256i r0 = _mm256_slli_epi32(cs, 7);
+            __m256i r1 = _mm256_slli_epi32(cs, 6);
+            a11 = chooseAVX2(r1, chooseAVX2(r0, v00, v10), chooseAVX2(r0, v01, v11));
+        }
+        else
+        {
+            a11 = select4AVX2(cs, vst, v00, v01, v10, v11);
+        }
+
+        __m256i lo = _mm256_unpacklo_epi32(v00, a10);
+        __m256i hi = _mm256_unpackhi_epi32(v00, a10);
+        _mm256_storeu_si256((__m256i*) (b0 + 2*i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*) (b0 + 2*i + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+        lo = _mm256_unpacklo_epi32(a01, a11);
+        hi = _mm256_unpackhi_epi32(a01, a11);
+        _mm256_storeu_si256((__m256i*) (b1 + 2*i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*) (b1 + 2*i + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    return i;
+}
+
+ATTR(target("sse4.1"))
+static inline __m128i stepSeedSSE41(__m128i cs, __m128i salt)
+{
+    __m128i t = _mm_mullo_epi32(cs, _mm_set1_epi32(1284865837));
+    t = _mm_add_epi32(t, _mm_set1_epi32((int)4150755663U));
+    return _mm_add_epi32(_mm_mullo_epi32(cs, t), salt);
+}
+
+ATTR(target("sse4.1"))
+static inline __m128i chooseSSE41(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_blendv_epi8(a, b, _mm_srai_epi32(mask, 31));
+}
+
+ATTR(target("sse4.1"))
+static inline __m128i select4SSE41(__m128i cs, __m128i st,
+    __m128i v00, __m128i v01, __m128i v10, __m128i v11)
+{
+    __m128i c00 = _mm_add_epi32(_mm_cmpeq_epi32(v00, v10),
+        _mm_add_epi32(_mm_cmpeq_epi32(v00, v01), _mm_cmpeq_epi32(v00, v11)));
+    __m128i c10 = _mm_add_epi32(_mm_cmpeq_epi32(v10, v01),
+        _mm_cmpeq_epi32(v10, v11));
+    __m128i c01 = _mm_cmpeq_epi32(v01, v11);
+    __m128i m00 = _mm_and_si128(_mm_cmpgt_epi32(c10, c00),
+        _mm_cmpgt_epi32(c01, c00));
+    __m128i m10 = _mm_cmpgt_epi32(c00, c10);
+    __m128i m01 = _mm_cmpgt_epi32(c00, c01);
+
+    cs = stepSeedSSE41(cs, st);
+    __m128i r0 = _mm_slli_epi32(cs, 7);
+    __m128i r1 = _mm_slli_epi32(cs, 6);
+    __m128i v = chooseSSE41(r1, chooseSSE41(r0, v00, v10), chooseSSE41(r0, v01, v11));
+    v = _mm_blendv_epi8(v, v01, m01);
+    v = _mm_blendv_epi8(v, v10, m10);
+    return _mm_blendv_epi8(v, v00, m00);
+}
+
+ATTR(target("sse4.1"))
+static int mapZoomRowSSE41(const int *vz0, const int *vz1, int *b0, int *b1,
+    int n, uint32_t ss, uint32_t st, int cx, int cz, int fuzzy)
+{
+    const __m128i lane = _mm_setr_epi32(0, 2, 4, 6);
+    const __m128i vst = _mm_set1_epi32(st);
+    const __m128i vz = _mm_set1_epi32(cz);
+    int i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        __m128i v00 = _mm_loadu_si128((const __m128i*) (vz0 + i));
+        __m128i v10 = _mm_loadu_si128((const __m128i*) (vz0 + i + 1));
+        __m128i v01 = _mm_loadu_si128((const __m128i*) (vz1 + i));
+        __m128i v11 = _mm_loadu_si128((const __m128i*) (vz1 + i + 1));
+
+        __m128i vx = _mm_add_epi32(_mm_set1_epi32(cx + 2*i), lane);
+        __m128i cs = _mm_add_epi32(_mm_set1_epi32(ss), vx);
+        cs = stepSeedSSE41(cs, vz);
+        cs = stepSeedSSE41(cs, vx);
+        cs = stepSeedSSE41(cs, vz);
+        __m128i a01 = chooseSSE41(_mm_slli_epi32(cs, 7), v00, v01);
+        cs = stepSeedSSE41(cs, vst);
+        __m128i a10 = chooseSSE41(_mm_slli_epi32(cs, 7), v00, v10);
+        __m128i a11;
+        if (fuzzy)
+        {
+            cs = stepSeedSSE41(cs, vst);
+            __m128i r0 = _mm_slli_epi32(cs, 7);
+            __m128i r1 = _mm_slli_epi32(cs, 6);
+            a11 = chooseSSE41(r1, chooseSSE41(r0, v00, v10), chooseSSE41(r0, v01, v11));
+        }
+        else
+        {
+            a11 = select4SSE41(cs, vst, v00, v01, v10, v11);
+        }
+
+        _mm_storeu_si128((__m128i*) (b0 + 2*i), _mm_unpacklo_epi32(v00, a10));
+        _mm_storeu_si128((__m128i*) (b0 + 2*i + 4), _mm_unpackhi_epi32(v00, a10));
+        _mm_storeu_si128((__m128i*) (b1 + 2*i), _mm_unpacklo_epi32(a01, a11));
+        _mm_storeu_si128((__m128i*) (b1 + 2*i + 4), _mm_unpackhi_epi32(a01, a11));
+    }
+    return i;
+}
+
+/// Processes the leading cells of a row of mapZoom() or mapZoomFuzzy().
+static int mapZoomRow(const int *vz0, const int *vz1, int *b0, int *b1,
+    int n, uint32_t ss, uint32_t st, int cx, int cz, int fuzzy)
+{
+    if (__builtin_cpu_supports("avx2"))
+        return mapZoomRowAVX2(vz0, vz1, b0, b1, n, ss, st, cx, cz, fuzzy);
+    if (__builtin_cpu_supports("sse4.1"))
+        return mapZoomRowSSE41(vz0, vz1, b0, b1, n, ss, st, cx, cz, fuzzy);
+    return 0;
+}
+#endif // LAYER_SIMD_X86
+
 int mapZoomFuzzy(const Layer * l, int * out, int x, int z, int w, int h)
 {
     int pX = x >> 1;
@@ -105,12 +308,17 @@ int mapZoomFuzzy(const Layer * l, int * out, int x, int z, int w, int h)
 
     for (j = 0; j < pH; j++)
     {
-        idx = (j * 2) * newW;
+        i = 0;
+#if LAYER_SIMD_X86
+        i = mapZoomRow(out + (j+0)*pW, out + (j+1)*pW, buf + (j*2)*newW,
+            buf + (j*2+1)*newW, pW, ss, st, pX*2, (j+pZ)*2, 1);
+#endif
+        idx = (j * 2) * newW + i * 2;
 
-        v00 = out[(j+0)*pW];
-        v01 = out[(j+1)*pW];
+        v00 = out[i + (j+0)*pW];
+        v01 = out[i + (j+1)*pW];
 
-        for (i = 0; i < pW; i++, v00 = v10, v01 = v11)
+        for (; i < pW; i++, v00 = v10, v01 = v11)
         {
             v10 = out[i+1 + (j+0)*pW];
             v11 = out[i+1 + (j+1)*pW];
@@ -209,12 +417,17 @@ int mapZoom(const Layer * l, int * out, int x, int z, int w, int h)
 
     for (j = 0; j < pH; j++)
     {
-        idx = (j * 2) * newW;
+        i = 0;
+#if LAYER_SIMD_X86
+        i = mapZoomRow(out + (j+0)*pW, out + (j+1)*pW, buf + (j*2)*newW,
+            buf + (j*2+1)*newW, pW, ss, st, pX*2, (j+pZ)*2, 0);
+#endif
+        idx = (j * 2) * newW + i * 2;
 
-        v00 = out[(j+0)*pW];
-        v01 = out[(j+1)*pW];
+        v00 = out[i + (j+0)*pW];
+        v01 = out[i + (j+1)*pW];
 
-        for (i = 0; i < pW; i++, v00 = v10, v01 = v11)
+        for (; i < pW; i++, v00 = v10, v01 = v11)
         {
             v10 = out[i+1 + (j+0)*pW];
             v11 = out[i+1 + (j+1)*pW];
@@ -1309,6 +1522,85 @@ int mapRiver(const Layer * l, int * out, int x, int z, int w, int h)
 }
 
 
+#if LAYER_SIMD_X86
+ATTR(target("avx2"))
+static int mapSmoothRowAVX2(const int *vz0, const int *vz1, const int *vz2,
+    int *o, int n, uint32_t ss, int cx, int cz)
+{
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i vz = _mm256_set1_epi32(cz);
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        __m256i v11 = _mm256_loadu_si256((const __m256i*) (vz1 + i + 1));
+        __m256i v01 = _mm256_loadu_si256((const __m256i*) (vz1 + i));
+        __m256i v10 = _mm256_loadu_si256((const __m256i*) (vz0 + i + 1));
+        __m256i v21 = _mm256_loadu_si256((const __m256i*) (vz1 + i + 2));
+        __m256i v12 = _mm256_loadu_si256((const __m256i*) (vz2 + i + 1));
+        __m256i e1 = _mm256_cmpeq_epi32(v01, v21);
+        __m256i e2 = _mm256_cmpeq_epi32(v10, v12);
+
+        __m256i vx = _mm256_add_epi32(_mm256_set1_epi32(cx + i), lane);
+        __m256i cs = _mm256_add_epi32(_mm256_set1_epi32(ss), vx);
+        cs = stepSeedAVX2(cs, vz);
+        cs = stepSeedAVX2(cs, vx);
+        cs = stepSeedAVX2(cs, vz);
+
+        __m256i v = _mm256_blendv_epi8(v11, v01, e1);
+        v = _mm256_blendv_epi8(v, v10, e2);
+        v = _mm256_blendv_epi8(v, chooseAVX2(_mm256_slli_epi32(cs, 7), v01, v10),
+            _mm256_and_si256(e1, e2));
+        _mm256_storeu_si256((__m256i*) (o + i), v);
+    }
+    return i;
+}
+
+ATTR(target("sse4.1"))
+static int mapSmoothRowSSE41(const int *vz0, const int *vz1, const int *vz2,
+    int *o, int n, uint32_t ss, int cx, int cz)
+{
+    const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i vz = _mm_set1_epi32(cz);
+    int i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        __m128i v11 = _mm_loadu_si128((const __m128i*) (vz1 + i + 1));
+        __m128i v01 = _mm_loadu_si128((const __m128i*) (vz1 + i));
+        __m128i v10 = _mm_loadu_si128((const __m128i*) (vz0 + i + 1));
+        __m128i v21 = _mm_loadu_si128((const __m128i*) (vz1 + i + 2));
+        __m128i v12 = _mm_loadu_si128((const __m128i*) (vz2 + i + 1));
+        __m128i e1 = _mm_cmpeq_epi32(v01, v21);
+        __m128i e2 = _mm_cmpeq_epi32(v10, v12);
+
+        __m128i vx = _mm_add_epi32(_mm_set1_epi32(cx + i), lane);
+        __m128i cs = _mm_add_epi32(_mm_set1_epi32(ss), vx);
+        cs = stepSeedSSE41(cs, vz);
+        cs = stepSeedSSE41(cs, vx);
+        cs = stepSeedSSE41(cs, vz);
+
+        __m128i v = _mm_blendv_epi8(v11, v01, e1);
+        v = _mm_blendv_epi8(v, v10, e2);
+        v = _mm_blendv_epi8(v, chooseSSE41(_mm_slli_epi32(cs, 7), v01, v10),
+            _mm_and_si128(e1, e2));
+        _mm_storeu_si128((__m128i*) (o + i), v);
+    }
+    return i;
+}
+
+/// Processes the leading cells of a row of mapSmooth().
+static int mapSmoothRow(const int *vz0, const int *vz1, const int *vz2,
+    int *o, int n, uint32_t ss, int cx, int cz)
+{
+    if (__builtin_cpu_supports("avx2"))
+        return mapSmoothRowAVX2(vz0, vz1, vz2, o, n, ss, cx, cz);
+    if (__builtin_cpu_supports("sse4.1"))
+        return mapSmoothRowSSE41(vz0, vz1, vz2, o, n, ss, cx, cz);
+    return 0;
+}
+#endif // LAYER_SIMD_X86
+
 int mapSmooth(const Layer * l, int * out, int x, int z, int w, int h)
 {
     int pX = x - 1;
@@ -1330,7 +1622,11 @@ int mapSmooth(const Layer * l, int * out, int x, int z, int w, int h)
         int *vz1 = out + (j+1)*pW;
         int *vz2 = out + (j+2)*pW;
 
-        for (i = 0; i < w; i++)
+        i = 0;
+#if LAYER_SIMD_X86
+        i = mapSmoothRow(vz0, vz1, vz2, out + j*w, w, ss, x, j+z);
+#endif
+        for (; i < w; i++)
         {
             int v11 = vz1[i+1];
             int v01 = vz1[i+0];
@@ -1908,12 +2204,11 @@ void mapVoronoiPlane(uint64_t sha, int *out, int *src,
 
 int mapVoronoi(const Layer * l, int * out, int x, int z, int w, int h)
 {
-    x -= 2;
-    z -= 2;
-    int px = x >> 2;
-    int pz = z >> 2;
-    int pw = ((x + w) >> 2) - px + 2;
-    int ph = ((z + h) >> 2) - pz + 2;
+    // the source range is offset by 2, which mapVoronoiPlane() applies itself
+    int px = (x - 2) >> 2;
+    int pz = (z - 2) >> 2;
+    int pw = ((x - 2 + w) >> 2) - px + 2;
+    int ph = ((z - 2 + h) >> 2) - pz + 2;
 
     if (l->p)
     {
@@ -2181,4 +2476,1228 @@ void voronoiAccess3D(uint64_t sha, int x, int y, int z, int *x4, int *y4, int *z
 }
 
 
+//==============================================================================
+// Layer Tile Cache
+//==============================================================================
+
+static inline uint64_t getTileHash(uint64_t seed, int lid, int tx, int tz)
+{
+    uint64_t h = seed ^ ((uint64_t)(uint32_t)tx << 32) ^ (uint32_t)tz;
+    h += (uint64_t)lid * 0x9e3779b97f4a7c15ULL;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+static inline int floorDiv(int a, int b)
+{
+    return a >= 0 ? a / b : -((-(int64_t)a - 1) / b) - 1;
+}
+
+static void unlinkTile(TileCache *tc, int i)
+{
+    TileCacheEntry *e = tc->ent + i;
+    if (e->next == i)
+    {
+        tc->head = -1;
+        return;
+    }
+    tc->ent[e->prev].next = e->next;
+    tc->ent[e->next].prev = e->prev;
+    if (tc->head == i)
+        tc->head = e->next;
+}
+
+static void pushTile(TileCache *tc, int i)
+{
+    TileCacheEntry *e = tc->ent + i;
+    if (tc->head < 0)
+    {
+        e->prev = e->next = i;
+    }
+    else
+    {
+        TileCacheEntry *h = tc->ent + tc->head;
+        e->next = tc->head;
+        e->prev = h->prev;
+        tc->ent[h->prev].next = i;
+        h->prev = i;
+    }
+    tc->head = i;
+}
+
+int initTileCache(TileCache *tc, int tsize, int cap)
+{
+    memset(tc, 0, sizeof(*tc));
+    if (tsize <= 0 || cap <= 0 || cap > (1 << 28))
+        return 1;
+    int hcnt = 1;
+    while (hcnt < 2 * cap)
+        hcnt <<= 1;
+    tc->tsize = tsize;
+    tc->cap = cap;
+    tc->hmask = hcnt - 1;
+    tc->htab = (int*) malloc(hcnt * sizeof(int));
+    tc->ent = (TileCacheEntry*) malloc(cap * sizeof(TileCacheEntry));
+    tc->ids = (int*) malloc((size_t)cap * tsize * tsize * sizeof(int));
+    if (!tc->htab || !tc->ent || !tc->ids)
+    {
+        freeTileCache(tc);
+        return 1;
+    }
+    clearTileCache(tc);
+    return 0;
+}
+
+void freeTileCache(TileCache *tc)
+{
+    int i;
+    for (i = 0; i < tc->laycnt; i++)
+        free(tc->lay[i].buf);
+    free(tc->htab);
+    free(tc->ent);
+    free(tc->ids);
+    memset(tc, 0, sizeof(*tc));
+}
+
+void clearTileCache(TileCache *tc)
+{
+    int i;
+    tc->cnt = 0;
+    tc->head = -1;
+    for (i = 0; i <= tc->hmask; i++)
+        tc->htab[i] = -1;
+}
+
+int attachTileCache(TileCache *tc, Layer *l)
+{
+    if (l->getMap == mapTileCached)
+    {
+        if (((TileLayer*)l->data)->tc == tc)
+            return 0;
+        detachTileCache(l);
+    }
+    if (l->data != NULL)
+    {
+        printf("attachTileCache(): layer at scale 1:%d has custom data\n",
+            l->scale);
+        return 1;
+    }
+
+    int lid;
+    for (lid = 0; lid < tc->laycnt; lid++)
+        if (tc->lay[lid].map == NULL)
+            break;
+    if (lid == L_NUM)
+    {
+        printf("attachTileCache(): too many cached layers\n");
+        return 1;
+    }
+
+    TileLayer *tl = tc->lay + lid;
+    size_t siz = getMinLayerCacheSize(l, tc->tsize, tc->tsize);
+    tl->buf = (int*) malloc(siz * sizeof(int));
+    if (!tl->buf)
+        return 1;
+    if (lid == tc->laycnt)
+        tc->laycnt++;
+    tl->tc = tc;
+    tl->map = l->getMap;
+    tl->seed = 0;
+    tl->seeded = 0;
+    l->getMap = mapTileCached;
+    l->data = tl;
+    clearTileCache(tc);
+    return 0;
+}
+
+void detachTileCache(Layer *l)
+{
+    if (l->getMap != mapTileCached)
+        return;
+    TileLayer *tl = (TileLayer*) l->data;
+    TileCache *tc = tl->tc;
+    l->getMap = tl->map;
+    l->data = NULL;
+    free(tl->buf);
+    memset(tl, 0, sizeof(*tl));
+    clearTileCache(tc);
+}
+
+void suspendTileCache(LayerStack *ls, TileLayer **saved)
+{
+    int i;
+    for (i = 0; i < L_NUM; i++)
+    {
+        Layer *l = ls->layers + i;
+        saved[i] = NULL;
+        if (l->getMap != mapTileCached)
+            continue;
+        saved[i] = (TileLayer*) l->data;
+        l->getMap = saved[i]->map;
+        l->data = NULL;
+    }
+}
+
+void resumeTileCache(LayerStack *ls, TileLayer **saved)
+{
+    int i;
+    for (i = 0; i < L_NUM; i++)
+    {
+        if (saved[i] == NULL)
+            continue;
+        Layer *l = ls->layers + i;
+        l->getMap = mapTileCached;
+        l->data = saved[i];
+        // the layer may have been reseeded without updating the tile seed
+        saved[i]->seeded = 0;
+    }
+}
+
+/* Finds or generates tile (tx,tz) of the cached layer 'l'. The returned tile
+ * is only valid until the cache is used again.
+ */
+static const int *getTile(const Layer *l, int tx, int tz, int *err)
+{
+    TileLayer *tl = (TileLayer*) l->data;
+    TileCache *tc = tl->tc;
+    int lid = (int)(tl - tc->lay);
+    int t = tc->tsize;
+    size_t tarea = (size_t)t * t;
+    uint64_t h = getTileHash(tl->seed, lid, tx, tz);
+    int *bucket = tc->htab + (h & tc->hmask);
+    TileCacheEntry *e;
+    int i;
+
+    for (i = *bucket; i >= 0; i = e->hnext)
+    {
+        e = tc->ent + i;
+        if (e->tx == tx && e->tz == tz && e->lid == lid && e->seed == tl->seed)
+        {
+            tc->hits++;
+            if (i != tc->head)
+            {
+                unlinkTile(tc, i);
+                pushTile(tc, i);
+            }
+            return tc->ids + i * tarea;
+        }
+    }
+
+    // generate the tile first, as the parents may update the cache
+    tc->misses++;
+    memset(tl->buf, 0, tarea * sizeof(int));
+    *err = tl->map(l, tl->buf, tx * t, tz * t, t, t);
+    if (*err)
+        return NULL;
+
+    if (tc->cnt < tc->cap)
+    {
+        i = tc->cnt++;
+    }
+    else
+    {   // replace the least recently used tile
+        i = tc->ent[tc->head].prev;
+        e = tc->ent + i;
+        int *p = tc->htab + (getTileHash(e->seed, e->lid, e->tx, e->tz) & tc->hmask);
+        while (*p != i)
+            p = &tc->ent[*p].hnext;
+        *p = e->hnext;
+        unlinkTile(tc, i);
+    }
+
+    e = tc->ent + i;
+    e->seed = tl->seed;
+    e->tx = tx;
+    e->tz = tz;
+    e->lid = lid;
+    e->hnext = *bucket;
+    *bucket = i;
+    pushTile(tc, i);
+    memcpy(tc->ids + i * tarea, tl->buf, tarea * sizeof(int));
+    return tc->ids + i * tarea;
+}
+
+int mapTileCached(const Layer * l, int * out, int x, int z, int w, int h)
+{
+    const TileLayer *tl = (const TileLayer*) l->data;
+    if (!tl->seeded)
+        return tl->map(l, out, x, z, w, h);
+
+    int t = tl->tc->tsize;
+    int tx0 = floorDiv(x, t), tx1 = floorDiv(x + w - 1, t);
+    int tz0 = floorDiv(z, t), tz1 = floorDiv(z + h - 1, t);
+    int tx, tz, err = 0;
+
+    for (tz = tz0; tz <= tz1; tz++)
+    {
+        for (tx = tx0; tx <= tx1; tx++)
+        {
+            const int *tile = getTile(l, tx, tz, &err);
+            if (tile == NULL)
+                return err;
+            int64_t i0 = (int64_t)tx * t, i1 = i0 + t;
+            int64_t j0 = (int64_t)tz * t, j1 = j0 + t;
+            int64_t ti = i0, tj = j0, j;
+            if (i0 < x) i0 = x;
+            if (j0 < z) j0 = z;
+            if (i1 > x + w) i1 = x + w;
+            if (j1 > z + h) j1 = z + h;
+            for (j = j0; j < j1; j++)
+            {
+                memcpy(out + (j - z) * w + (i0 - x),
+                    tile + (j - tj) * t + (i0 - ti),
+                    (i1 - i0) * sizeof(int));
+            }
+        }
+    }
+    return 0;
+}
+
+
+//==============================================================================
+//==============================================================================
+// Buffer Planning
+//==============================================================================
+
+/* The layers generate in place. A layer requests its parent area at the start
+ * of 'out' and reduces it to its own area. Zoom, voronoi and multi-parent
+ * layers put a second region directly behind the first one. The regions of
+ * sibling calls are not live at the same time, so the buffer for an area is
+ * the largest extent reached by any layer in the graph, taken for the worst
+ * alignment of the area.
+ */
+
+static size_t maxsz(size_t a, size_t b)
+{
+    return a > b ? a : b;
+}
+
+/* Largest parent span of 'w' cells at a zoom of 1<<s, plus the extra 'add'. */
+static int getParentSpan(int w, int s, int add)
+{
+    return ((w + (1 << s) - 1) >> s) + add;
+}
+
+static size_t getLayerPeak(const Layer *l, mapfunc_t *f, int w, int h)
+{
+    size_t a = (size_t)w * h;
+    int pw, ph;
+
+    if (f == mapTileCached)
+    {   // cached tiles are copied, but unseeded layers generate directly
+        f = ((const TileLayer*) l->data)->map;
+    }
+
+    if (f == mapContinent || f == mapOceanTemp)
+        return a;
+
+    if (f == mapZoom || f == mapZoomFuzzy)
+    {   // parent area followed by the doubled parent area
+        pw = getParentSpan(w, 1, 1);
+        ph = getParentSpan(h, 1, 1);
+        return maxsz(5 * (size_t)pw * ph, getLayerPeak(l->p, l->p->getMap, pw, ph));
+    }
+    if (f == mapVoronoi || f == mapVoronoi114)
+    {   // parent area and output area
+        pw = getParentSpan(w, 2, 2);
+        ph = getParentSpan(h, 2, 2);
+        size_t p = l->p ? getLayerPeak(l->p, l->p->getMap, pw, ph) : 0;
+        return maxsz(a + (size_t)pw * ph, p);
+    }
+    if (f == mapHills)
+    {
+        pw = w + 2;
+        ph = h + 2;
+        return maxsz(getLayerPeak(l->p, l->p->getMap, pw, ph),
+            (size_t)pw * ph + getLayerPeak(l->p2, l->p2->getMap, pw, ph));
+    }
+    if (f == mapRiverMix)
+    {
+        return maxsz(getLayerPeak(l->p, l->p->getMap, w, h),
+            a + getLayerPeak(l->p2, l->p2->getMap, w, h));
+    }
+    if (f == mapOceanMix)
+    {   // the land area extends by up to 8 and 9 cells for warm/frozen oceans
+        return maxsz(getLayerPeak(l->p2, l->p2->getMap, w, h),
+            a + getLayerPeak(l->p, l->p->getMap, w + 17, h + 17));
+    }
+    if (f == mapBiome || f == mapNoise || f == mapBamboo || f == mapSpecial ||
+        f == mapSunflower || f == mapSwampRiver)
+    {
+        return maxsz(a, getLayerPeak(l->p, l->p->getMap, w, h));
+    }
+    if (f == mapLand || f == mapLand16 || f == mapLandB18 || f == mapIsland ||
+        f == mapSnow || f == mapSnow16 || f == mapCool || f == mapHeat ||
+        f == mapMushroom || f == mapDeepOcean || f == mapBiomeEdge ||
+        f == mapRiver || f == mapSmooth || f == mapShore)
+    {
+        return maxsz(a, getLayerPeak(l->p, l->p->getMap, w + 2, h + 2));
+    }
+
+    // custom layers: zoom and multi-parent layers may keep a temporary copy of
+    // their parent area, as described by the layer attributes
+    int aw = w + l->edge;
+    int ah = h + l->edge;
+    int zs = l->zoom == 4 ? 2 : l->zoom == 2 ? 1 : 0;
+    size_t s = (l->p2 || l->zoom != 1) ? (size_t)aw * ah : 0;
+    size_t p = (size_t)aw * ah;
+    if (l->p)
+        p = maxsz(p, getLayerPeak(l->p, l->p->getMap, aw >> zs, ah >> zs));
+    if (l->p2)
+        p = maxsz(p, getLayerPeak(l->p2, l->p2->getMap, aw >> zs, ah >> zs));
+    return s + p;
+}
+
+size_t getMinLayerCacheSize(const Layer *layer, int sizeX, int sizeZ)
+{
+    return getLayerPeak(layer, layer->getMap, sizeX, sizeZ);
+}
+
+
+//==============================================================================
+// Multi-Seed Lanes
+//==============================================================================
+
+enum
+{
+    LANE_CONTINENT, LANE_ZOOM_FUZZY, LANE_ZOOM, LANE_LAND, LANE_ISLAND,
+    LANE_SNOW, LANE_COOL, LANE_HEAT, LANE_SPECIAL, LANE_MUSHROOM,
+    LANE_DEEP_OCEAN, LANE_BIOME, LANE_BAMBOO, LANE_NOISE,
+};
+
+static int getLaneKind(const Layer *l)
+{
+    mapfunc_t *f = l->getMap;
+    if (f == mapTileCached)
+        f = ((const TileLayer*)l->data)->map;
+    if (f == mapContinent)  return LANE_CONTINENT;
+    if (f == mapZoomFuzzy)  return LANE_ZOOM_FUZZY;
+    if (f == mapZoom)       return LANE_ZOOM;
+    if (f == mapLand)       return LANE_LAND;
+    if (f == mapIsland)     return LANE_ISLAND;
+    if (f == mapSnow)       return LANE_SNOW;
+    if (f == mapCool)       return LANE_COOL;
+    if (f == mapHeat)       return LANE_HEAT;
+    if (f == mapSpecial)    return LANE_SPECIAL;
+    if (f == mapMushroom)   return LANE_MUSHROOM;
+    if (f == mapDeepOcean)  return LANE_DEEP_OCEAN;
+    if (f == mapBamboo)     return LANE_BAMBOO;
+    if (f == mapNoise)      return LANE_NOISE;
+    if (f == mapBiome && l->mc > MC_1_6)
+        return LANE_BIOME;
+    return -1;
+}
+
+/* Determines the parent area [x,z,w,h] that a lane layer requires. */
+static void getLaneParentArea(int kind, int *a)
+{
+    switch (kind)
+    {
+    case LANE_ZOOM_FUZZY:
+    case LANE_ZOOM:
+        a[2] = ((a[0] + a[2]) >> 1) - (a[0] >> 1) + 1;
+        a[3] = ((a[1] + a[3]) >> 1) - (a[1] >> 1) + 1;
+        a[0] >>= 1;
+        a[1] >>= 1;
+        break;
+    case LANE_SPECIAL:
+    case LANE_BIOME:
+    case LANE_BAMBOO:
+    case LANE_NOISE:
+        break;
+    default:
+        a[0] -= 1;
+        a[1] -= 1;
+        a[2] += 2;
+        a[3] += 2;
+    }
+}
+
+#if LAYER_LANE_VEC
+
+/* The lane layers mirror the scalar layers above, but evaluate one cell for
+ * all seeds at once, using the vector extensions of GNU C. Each branch of the
+ * scalar code is computed for all lanes and the result is selected per lane.
+ * The PRNG state uses 64-bit lanes, while the biome ids and the 32-bit seeds
+ * of the zoom layers use 32-bit lanes. Cells where no lane requires any PRNG
+ * work are copied as a whole.
+ */
+// The helpers below are always inlined, so their vector ABI does not matter.
+// (GCC reports this at the end of the file, so the warning stays disabled.)
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+typedef int32_t     lane32_t    __attribute__((vector_size(4 * LANE_CNT)));
+typedef uint32_t    laneu32_t   __attribute__((vector_size(4 * LANE_CNT)));
+typedef int64_t     lane64_t    __attribute__((vector_size(8 * LANE_CNT)));
+typedef uint64_t    laneu64_t   __attribute__((vector_size(8 * LANE_CNT)));
+
+// selects 'A' in the lanes of mask 'M' and 'B' in the others
+#define LANE_SEL(M, A, B)   ({ lane32_t m_ = (M); ((A) & m_) | ((B) & ~m_); })
+#define LANE_ANY(M)         ({ lane32_t m_ = (M); int k_, r_ = 0; \
+                               for (k_ = 0; k_ < LANE_CNT; k_++) r_ |= m_[k_]; \
+                               r_ != 0; })
+#define LANE_SAVE(P, V)     ({ lane32_t v_ = (V); memcpy((P), &v_, sizeof(v_)); })
+
+static inline ATTR(always_inline)
+lane32_t laneLoad(const int *p)
+{
+    lane32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/* Applies mcStepSeed() to the lanes of 's' that are selected by 'm'. */
+static inline ATTR(always_inline)
+void laneStep(laneu64_t *s, const laneu64_t *salt, const lane32_t *m)
+{
+    laneu64_t m64 = (laneu64_t) __builtin_convertvector(*m, lane64_t);
+    laneu64_t n = *s * (*s * 6364136223846793005ULL + 1442695040888963407ULL);
+    *s = ((n + *salt) & m64) | (*s & ~m64);
+}
+
+static inline ATTR(always_inline)
+void laneChunkSeed(laneu64_t *cs, const laneu64_t *ss, int x, int z)
+{
+    const laneu64_t vx = (laneu64_t){0} + (uint64_t)(int64_t) x;
+    const laneu64_t vz = (laneu64_t){0} + (uint64_t)(int64_t) z;
+    const lane32_t all = (lane32_t){0} - 1;
+    *cs = *ss + vx;
+    laneStep(cs, &vz, &all);
+    laneStep(cs, &vx, &all);
+    laneStep(cs, &vz, &all);
+}
+
+/* Mask of the lanes for which mcFirstIsZero(s, mod) holds. The power of two
+ * factor of 'mod' is tested on the low bits of the 40-bit PRNG output, and
+ * the odd factor by a multiplication with its modular inverse, after the
+ * output has been offset by a multiple of it to become positive.
+ */
+static inline ATTR(always_inline)
+lane32_t laneIsZero(const laneu64_t *s, uint64_t mod)
+{
+    uint64_t pow2 = mod & -mod;
+    uint64_t odd = mod / pow2;
+    laneu64_t t = *s >> 24;
+    lane64_t m = (t & (pow2 - 1)) == 0;
+
+    if (odd > 1)
+    {
+        uint64_t inv = odd;
+        int i;
+        for (i = 0; i < 5; i++)
+            inv *= 2 - odd * inv;
+        uint64_t bias = odd * (((1ULL << 40) + odd - 1) / odd) - (1ULL << 40);
+        t += bias & (laneu64_t)((lane64_t)*s < 0);
+        m &= t * inv <= UINT64_MAX / odd;
+    }
+    return __builtin_convertvector(m, lane32_t);
+}
+
+/* Mask of the lanes for which mcFirstInt(s, mod) == r. */
+static inline ATTR(always_inline)
+lane32_t laneIsInt(const laneu64_t *s, uint64_t mod, uint64_t r)
+{
+    laneu64_t t = *s - (r << 24);
+    return laneIsZero(&t, mod);
+}
+
+static inline ATTR(always_inline)
+void lanesContinent(const uint64_t *ss, int *out, int x, int z, int w, int h)
+{
+    laneu64_t vss;
+    int64_t i, j;
+
+    memcpy(&vss, ss, sizeof(vss));
+    for (j = 0; j < h; j++)
+    {
+        for (i = 0; i < w; i++)
+        {
+            laneu64_t cs;
+            laneChunkSeed(&cs, &vss, i + x, j + z);
+            LANE_SAVE(out + (j*w + i) * LANE_CNT, laneIsZero(&cs, 10) & 1);
+        }
+    }
+
+    if (x > -w && x <= 0 && z > -h && z <= 0)
+    {
+        LANE_SAVE(out + (-z * (int64_t)w - x) * LANE_CNT, (lane32_t){0} + 1);
+    }
+}
+
+static inline ATTR(always_inline)
+void laneStore(int *out, int w, int h, int x, int z, const lane32_t *v)
+{
+    if ((uint32_t)x < (uint32_t)w && (uint32_t)z < (uint32_t)h)
+        memcpy(out + ((int64_t)z*w + x) * LANE_CNT, v, sizeof(*v));
+}
+
+static inline ATTR(always_inline)
+void lanesZoom(const uint64_t *st, const uint64_t *ss, int *out,
+    const int *src, int x, int z, int w, int h, int fuzzy)
+{
+    int pX = x >> 1;
+    int pZ = z >> 1;
+    int64_t pW = ((x + w) >> 1) - pX + 1;
+    int64_t pH = ((z + h) >> 1) - pZ + 1;
+    laneu64_t vst, vss;
+    int64_t i, j;
+
+    memcpy(&vst, st, sizeof(vst));
+    memcpy(&vss, ss, sizeof(vss));
+    // the zoom layers only use the lower 32 bits of the seeds
+    laneu32_t st32 = __builtin_convertvector(vst, laneu32_t);
+    laneu32_t ss32 = __builtin_convertvector(vss, laneu32_t);
+
+    for (j = 0; j < pH; j++)
+    {
+        int oz = 2*j - (z & 1);
+        // in the last row and column, the cells that depend on the missing
+        // neighbours lie outside of the area, so they are clamped
+        int64_t j1 = j+1 < pH ? j+1 : j;
+        for (i = 0; i < pW; i++)
+        {
+            int ox = 2*i - (x & 1);
+            int64_t i1 = i+1 < pW ? i+1 : i;
+            lane32_t v00 = laneLoad(src + (j *pW + i ) * LANE_CNT);
+            lane32_t v10 = laneLoad(src + (j *pW + i1) * LANE_CNT);
+            lane32_t v01 = laneLoad(src + (j1*pW + i ) * LANE_CNT);
+            lane32_t v11 = laneLoad(src + (j1*pW + i1) * LANE_CNT);
+
+            lane32_t e10 = v00 == v10, e01 = v00 == v01, e11 = v00 == v11;
+            if (!LANE_ANY(~(e10 & e01 & e11)))
+            {
+                laneStore(out, w, h, ox+0, oz+0, &v00);
+                laneStore(out, w, h, ox+1, oz+0, &v00);
+                laneStore(out, w, h, ox+0, oz+1, &v00);
+                laneStore(out, w, h, ox+1, oz+1, &v00);
+                continue;
+            }
+
+            uint32_t chunkX = (uint32_t)(i + pX) * 2;
+            uint32_t chunkZ = (uint32_t)(j + pZ) * 2;
+
+            laneu32_t cs = ss32;
+            cs += chunkX;
+            cs *= cs * 1284865837 + 4150755663;
+            cs += chunkZ;
+            cs *= cs * 1284865837 + 4150755663;
+            cs += chunkX;
+            cs *= cs * 1284865837 + 4150755663;
+            cs += chunkZ;
+
+            lane32_t c = LANE_SEL(((cs >> 24) & 1) != 0, v01, v00);
+
+            cs *= cs * 1284865837 + 4150755663;
+            cs += st32;
+            lane32_t b = LANE_SEL(((cs >> 24) & 1) != 0, v10, v00);
+
+            cs *= cs * 1284865837 + 4150755663;
+            cs += st32;
+            laneu32_t r = (cs >> 24) & 3;
+            lane32_t d = LANE_SEL(r == 0, v00, LANE_SEL(r == 1, v10,
+                         LANE_SEL(r == 2, v01, v11)));
+
+            if (!fuzzy)
+            {   // select4()
+                lane32_t cv00 = -(e10 + e01 + e11);
+                lane32_t cv10 = -((v10 == v01) + (v10 == v11));
+                lane32_t cv01 = -(v01 == v11);
+                d = LANE_SEL(cv01 > cv00, v01, d);
+                d = LANE_SEL(cv10 > cv00, v10, d);
+                d = LANE_SEL((cv00 > cv10) & (cv00 > cv01), v00, d);
+            }
+
+            laneStore(out, w, h, ox+0, oz+0, &v00);
+            laneStore(out, w, h, ox+1, oz+0, &b);
+            laneStore(out, w, h, ox+0, oz+1, &c);
+            laneStore(out, w, h, ox+1, oz+1, &d);
+        }
+    }
+}
+
+static inline ATTR(always_inline)
+void lanesLand(const uint64_t *st, const uint64_t *ss, int *out,
+    const int *src, int x, int z, int w, int h)
+{
+    int64_t pW = w + 2;
+    laneu64_t vst, vss;
+    int64_t i, j;
+
+    memcpy(&vst, st, sizeof(vst));
+    memcpy(&vss, ss, sizeof(vss));
+
+    for (j = 0; j < h; j++)
+    {
+        for (i = 0; i < w; i++)
+        {
+            lane32_t v00 = laneLoad(src + ((j+0)*pW + i+0) * LANE_CNT);
+            lane32_t v20 = laneLoad(src + ((j+0)*pW + i+2) * LANE_CNT);
+            lane32_t v02 = laneLoad(src + ((j+2)*pW + i+0) * LANE_CNT);
+            lane32_t v22 = laneLoad(src + ((j+2)*pW + i+2) * LANE_CNT);
+            lane32_t v11 = laneLoad(src + ((j+1)*pW + i+1) * LANE_CNT);
+            int *o = out + (j*w + i) * LANE_CNT;
+
+            lane32_t t00 = v00 != ocean;
+            lane32_t t20 = v20 != ocean;
+            lane32_t t02 = v02 != ocean;
+            lane32_t t22 = v22 != ocean;
+            lane32_t land = t00 | t20 | t02 | t22;
+            lane32_t sea = ~(t00 & t20 & t02 & t22);
+            lane32_t isocean = v11 == ocean;
+            lane32_t shore = (v11 != forest) & sea;
+
+            if (!LANE_ANY(LANE_SEL(isocean, land, shore)))
+            {
+                LANE_SAVE(o, v11);
+                continue;
+            }
+
+            laneu64_t cs;
+            laneChunkSeed(&cs, &vss, i + x, j + z);
+            lane32_t vs = LANE_SEL(shore & laneIsZero(&cs, 5), (lane32_t){0}, v11);
+            lane32_t v, inc, take;
+
+            inc = -t00;
+            v = LANE_SEL(t00, v00, (lane32_t){0} + 1);
+            laneStep(&cs, &vst, &t00);
+
+            inc -= t20;
+            take = (inc == 1) | laneIsZero(&cs, 2);
+            v = LANE_SEL(t20 & take, v20, v);
+            laneStep(&cs, &vst, &t20);
+
+            inc -= t02;
+            take = (inc == 1) |
+                ((inc == 2) & laneIsZero(&cs, 2)) |
+                ((inc == 3) & laneIsZero(&cs, 3));
+            v = LANE_SEL(t02 & take, v02, v);
+            laneStep(&cs, &vst, &t02);
+
+            inc -= t22;
+            take = (inc == 1) |
+                ((inc == 2) & laneIsZero(&cs, 2)) |
+                ((inc == 3) & laneIsZero(&cs, 3)) |
+                ((inc == 4) & laneIsZero(&cs, 4));
+            v = LANE_SEL(t22 & take, v22, v);
+            laneStep(&cs, &vst, &t22);
+
+            v &= ~((v != forest) & ~laneIsZero(&cs, 3));
+            LANE_SAVE(o, LANE_SEL(isocean, v & land, vs));
+        }
+    }
+}
+
+static inline ATTR(always_inline)
+void lanesIsland(const uint64_t *ss, int *out,
+    const int *src, int x, int z, int w, int h)
+{
+    int64_t pW = w + 2;
+    laneu64_t vss;
+    int64_t i, j;
+
+    memcpy(&vss, ss, sizeof(vss));
+    for (j = 0; j < h; j++)
+    {
+        for (i = 0; i < w; i++)
+        {
+            lane32_t v10 = laneLoad(src + ((j+0)*pW + i+1) * LANE_CNT);
+            lane32_t v21 = laneLoad(src + ((j+1)*pW + i+2) * LANE_CNT);
+            lane32_t v01 = laneLoad(src + ((j+1)*pW + i+0) * LANE_CNT);
+            lane32_t v12 = laneLoad(src + ((j+2)*pW + i+1) * LANE_CNT);
+            lane32_t v11 = laneLoad(src + ((j+1)*pW + i+1) * LANE_CNT);
+            int *o = out + (j*w + i) * LANE_CNT;
+
+            lane32_t sea = (v11 == Oceanic) & (v10 == Oceanic) &
+                (v21 == Oceanic) & (v01 == Oceanic) & (v12 == Oceanic);
+            if (LANE_ANY(sea))
+            {
+                laneu64_t cs;
+                laneChunkSeed(&cs, &vss, i + x, j + z);
+                v11 = LANE_SEL(sea & laneIsZero(&cs, 2), (lane32_t){0} + 1, v11);
+            }
+            LANE_SAVE(o, v11);
+        }
+    }
+}
+
+static inline ATTR(always_inline)
+lane32_t laneIsShallowOcean(const lane32_t *v)
+{
+    lane32_t id = *v;
+    return (id == ocean) | (id == frozen_ocean) | (id == warm_ocean) |
+        (id == lukewarm_ocean) | (id == cold_ocean);
+}
+
+static inline ATTR(always_inline)
+void lanesSnow(const uint64_t *ss, int *out,
+    const int *src, int x, int z, int w, int h)
+{
+    int64_t pW = w + 2;
+    laneu64_t vss;
+    int64_t i, j;
+
+    memcpy(&vss, ss, sizeof(vss));
+    for (j = 0; j < h; j++)
+    {
+        for (i = 0; i < w; i++)
+        {
+            lane32_t v11 = laneLoad(src + ((j+1)*pW + i+1) * LANE_CNT);
+            int *o = out + (j*w + i) * LANE_CNT;
+            lane32_t land = ~laneIsShallowOcean(&v11);
+
+            if (LANE_ANY(land))
+            {
+                laneu64_t cs;
+                laneChunkSeed(&cs, &vss, i + x, j + z);
+                lane32_t v = (lane32_t){0} + Warm;
+                v = LANE_SEL(laneIsInt(&cs, 6, 1), (lane32_t){0} + Cold, v);
+                v = LANE_SEL(laneIsInt(&cs, 6, 0), (lane32_t){0} + Freezing, v);
+                v11 = LANE_SEL(land, v, v11);
+            }
+            LANE_SAVE(o, v11);
+        }
+    }
+}
+
+static inline ATTR(always_inline)
+void lanesClimate(int *out, const int *src, int w, int h,
+    int from, int near1, int near2, int to)
+{
+    int64_t pW = w + 2;
+    int64_t i, j;
+
+    for (j = 0; j < h; j++)
+    {
+        for (i = 0; i < w; i++)
+        {
+            lane32_t v10 = laneLoad(src + ((j+0)*pW + i+1) * LANE_CNT);
+            lane32_t v21 = laneLoad(src + ((j+1)*pW + i+2) * LANE_CNT);
+            lane32_t v01 = laneLoad(src + ((j+1)*pW + i+0) * LANE_CNT);
+            lane32_t v12 = laneLoad(src + ((j+2)*pW + i+1) * LANE_CNT);
+            lane32_t v11 = laneLoad(src + ((j+1)*pW + i+1) * LANE_CNT);
+            lane32_t n =
+                (v10 == near1) | (v21 == near1) | (v01 == near1) | (v12 == near1) |
+                (v10 == near2) | (v21 == near2) | (v01 == near2) | (v12 == near2);
+            v11 = LANE_SEL((v11 == from) & n, (lane32_t){0} + to, v11);
+            LANE_SAVE(out + (j*w + i) * LANE_CNT, v11);
+        }
+    }
+}
+
+static inline ATTR(always_inline)
+void lanesSpecial(const uint64_t *st, const uint64_t *ss, int *out,
+    const int *src, int x, int z, int w, int h)
+{
+    laneu64_t vss;
+    int64_t i, j;
+    int k;
+
+    memcpy(&vss, ss, sizeof(vss));
+    for (j = 0; j < h; j++)
+    {
+        for (i = 0; i < w; i++)
+        {
+            lane32_t v = laneLoad(src + (j*w + i) * LANE_CNT);
+            laneu64_t cs;
+            laneChunkSeed(&cs, &vss, i + x, j + z);
+            lane32_t t = (v != Oceanic) & laneIsZero(&cs, 13);
+
+            if (LANE_ANY(t))
+            {   // rare enough to finish per lane
+                for (k = 0; k < LANE_CNT; k++)
+                {
+                    if (!t[k])
+                        continue;
+                    uint64_t c = mcStepSeed(cs[k], st[k]);
+                    v[k] |= (uint32_t)(1 + mcFirstInt(c, 15)) << 8 & 0xf00;
+                }
+            }
+            LANE_SAVE(out + (j*w + i) * LANE_CNT, v);
+        }
+    }
+}
+
+static inline ATTR(always_inline)
+void lanesMushroom(const uint64_t *ss, int *out,
+    const int *src, int x, int z, int w, int h)
+{
+    int64_t pW = w + 2;
+    laneu64_t vss;
+    int64_t i, j;
+
+    memcpy(&vss, ss, sizeof(vss));
+    for (j = 0; j < h; j++)
+    {
+        for (i = 0; i < w; i++)
+        {
+            lane32_t v00 = laneLoad(src + ((j+0)*pW + i+0) * LANE_CNT);
+            lane32_t v20 = laneLoad(src + ((j+0)*pW + i+2) * LANE_CNT);
+            lane32_t v02 = laneLoad(src + ((j+2)*pW + i+0) * LANE_CNT);
+            lane32_t v22 = laneLoad(src + ((j+2)*pW + i+2) * LANE_CNT);
+            lane32_t v11 = laneLoad(src + ((j+1)*pW + i+1) * LANE_CNT);
+
+            lane32_t sea = (v11 == 0) & (v00 == 0) & (v20 == 0) &
+                (v02 == 0) & (v22 == 0);
+            if (LANE_ANY(sea))
+            {
+                laneu64_t cs;
+                laneChunkSeed(&cs, &vss, i + x, j + z);
+                v11 = LANE_SEL(sea & laneIsZero(&cs, 100),
+                    (lane32_t){0} + mushroom_fields, v11);
+            }
+            LANE_SAVE(out + (j*w + i) * LANE_CNT, v11);
+        }
+    }
+}
+
+static inline ATTR(always_inline)
+void lanesDeepOcean(int *out, const int *src, int w, int h)
+{
+    int64_t pW = w + 2;
+    int64_t i, j;
+
+    for (j = 0; j < h; j++)
+    {
+        for (i = 0; i < w; i++)
+        {
+            lane32_t v10 = laneLoad(src + ((j+0)*pW + i+1) * LANE_CNT);
+            lane32_t v21 = laneLoad(src + ((j+1)*pW + i+2) * LANE_CNT);
+            lane32_t v01 = laneLoad(src + ((j+1)*pW + i+0) * LANE_CNT);
+            lane32_t v12 = laneLoad(src + ((j+2)*pW + i+1) * LANE_CNT);
+            lane32_t v = laneLoad(src + ((j+1)*pW + i+1) * LANE_CNT);
+
+            lane32_t t = laneIsShallowOcean(&v) &
+                laneIsShallowOcean(&v10) & laneIsShallowOcean(&v21) &
+                laneIsShallowOcean(&v01) & laneIsShallowOcean(&v12);
+            lane32_t d = (lane32_t){0} + deep_ocean;
+            d = LANE_SEL(v == warm_ocean, (lane32_t){0} + deep_warm_ocean, d);
+            d = LANE_SEL(v == lukewarm_ocean, (lane32_t){0} + deep_lukewarm_ocean, d);
+            d = LANE_SEL(v == cold_ocean, (lane32_t){0} + deep_cold_ocean, d);
+            d = LANE_SEL(v == frozen_ocean, (lane32_t){0} + deep_frozen_ocean, d);
+            LANE_SAVE(out + (j*w + i) * LANE_CNT, LANE_SEL(t, d, v));
+        }
+    }
+}
+
+static inline ATTR(always_inline)
+void lanesBiome(const uint64_t *ss, int *out,
+    const int *src, int x, int z, int w, int h)
+{
+    laneu64_t vss;
+    int64_t i, j;
+    int k;
+
+    memcpy(&vss, ss, sizeof(vss));
+    for (j = 0; j < h; j++)
+    {
+        for (i = 0; i < w; i++)
+        {
+            lane32_t p = laneLoad(src + (j*w + i) * LANE_CNT);
+            laneu64_t cs;
+            laneChunkSeed(&cs, &vss, i + x, j + z);
+            int *o = out + (j*w + i) * LANE_CNT;
+
+            // the table lookups are done per lane
+            for (k = 0; k < LANE_CNT; k++)
+            {
+                int hasHighBit = p[k] & 0xf00;
+                int id = p[k] & ~0xf00;
+                int v;
+
+                if (isOceanic(id) || id == mushroom_fields)
+                {
+                    o[k] = id;
+                    continue;
+                }
+                switch (id)
+                {
+                case Warm:
+                    if (hasHighBit) v = mcFirstIsZero(cs[k], 3) ? badlands_plateau : wooded_badlands_plateau;
+                    else v = warmBiomes[mcFirstInt(cs[k], 6)];
+                    break;
+                case Lush:
+                    if (hasHighBit) v = jungle;
+                    else v = lushBiomes[mcFirstInt(cs[k], 6)];
+                    break;
+                case Cold:
+                    if (hasHighBit) v = giant_tree_taiga;
+                    else v = coldBiomes[mcFirstInt(cs[k], 4)];
+                    break;
+                case Freezing:
+                    v = snowBiomes[mcFirstInt(cs[k], 4)];
+                    break;
+                default:
+                    v = mushroom_fields;
+                }
+                o[k] = v;
+            }
+        }
+    }
+}
+
+static inline ATTR(always_inline)
+void lanesBamboo(const uint64_t *ss, int *out,
+    const int *src, int x, int z, int w, int h)
+{
+    laneu64_t vss;
+    int64_t i, j;
+
+    memcpy(&vss, ss, sizeof(vss));
+    for (j = 0; j < h; j++)
+    {
+        for (i = 0; i < w; i++)
+        {
+            lane32_t v = laneLoad(src + (j*w + i) * LANE_CNT);
+            lane32_t t = v == jungle;
+            if (LANE_ANY(t))
+            {
+                laneu64_t cs;
+                laneChunkSeed(&cs, &vss, i + x, j + z);
+                v = LANE_SEL(t & laneIsZero(&cs, 10),
+                    (lane32_t){0} + bamboo_jungle, v);
+            }
+            LANE_SAVE(out + (j*w + i) * LANE_CNT, v);
+        }
+    }
+}
+
+static inline ATTR(always_inline)
+void lanesNoise(const uint64_t *ss, int *out,
+    const int *src, int x, int z, int w, int h, int mod)
+{
+    laneu64_t vss;
+    int64_t i, j;
+    int k;
+
+    memcpy(&vss, ss, sizeof(vss));
+    for (j = 0; j < h; j++)
+    {
+        for (i = 0; i < w; i++)
+        {
+            const int *v = src + (j*w + i) * LANE_CNT;
+            int *o = out + (j*w + i) * LANE_CNT;
+            laneu64_t cs;
+            laneChunkSeed(&cs, &vss, i + x, j + z);
+            for (k = 0; k < LANE_CNT; k++)
+                o[k] = v[k] > 0 ? mcFirstInt(cs[k], mod) + 2 : 0;
+        }
+    }
+}
+
+/* Runs a chain of lane layers, from the root chain[n-1] to chain[0], where
+ * the results alternate between the two buffers such that the last one ends
+ * up in 'buf0'.
+ */
+static inline ATTR(always_inline)
+void runLaneChain(int n, const Layer **chain, const int *kind, int (*area)[4],
+    uint64_t (*st)[LANE_CNT], uint64_t (*ss)[LANE_CNT], int *buf0, int *buf1)
+{
+    int i;
+    for (i = n-1; i >= 0; i--)
+    {
+        int *out = (i & 1) ? buf1 : buf0;
+        const int *src = (i & 1) ? buf0 : buf1;
+        int x = area[i][0], z = area[i][1], w = area[i][2], h = area[i][3];
+
+        switch (kind[i])
+        {
+        case LANE_CONTINENT:
+            lanesContinent(ss[i], out, x, z, w, h);
+            break;
+        case LANE_ZOOM_FUZZY:
+            lanesZoom(st[i], ss[i], out, src, x, z, w, h, 1);
+            break;
+        case LANE_ZOOM:
+            lanesZoom(st[i], ss[i], out, src, x, z, w, h, 0);
+            break;
+        case LANE_LAND:
+            lanesLand(st[i], ss[i], out, src, x, z, w, h);
+            break;
+        case LANE_ISLAND:
+            lanesIsland(ss[i], out, src, x, z, w, h);
+            break;
+        case LANE_SNOW:
+            lanesSnow(ss[i], out, src, x, z, w, h);
+            break;
+        case LANE_COOL:
+            lanesClimate(out, src, w, h, Warm, Cold, Freezing, Lush);
+            break;
+        case LANE_HEAT:
+            lanesClimate(out, src, w, h, Freezing, Warm, Lush, Cold);
+            break;
+        case LANE_SPECIAL:
+            lanesSpecial(st[i], ss[i], out, src, x, z, w, h);
+            break;
+        case LANE_MUSHROOM:
+            lanesMushroom(ss[i], out, src, x, z, w, h);
+            break;
+        case LANE_DEEP_OCEAN:
+            lanesDeepOcean(out, src, w, h);
+            break;
+        case LANE_BIOME:
+            lanesBiome(ss[i], out, src, x, z, w, h);
+            break;
+        case LANE_BAMBOO:
+            lanesBamboo(ss[i], out, src, x, z, w, h);
+            break;
+        case LANE_NOISE:
+            if (chain[i]->mc <= MC_1_6)
+                lanesNoise(ss[i], out, src, x, z, w, h, 2);
+            else
+                lanesNoise(ss[i], out, src, x, z, w, h, 299999);
+            break;
+        }
+    }
+}
+
+#if LAYER_SIMD_X86
+static ATTR(target("avx512f,avx512dq,avx512vl,avx512bw"))
+void runLaneChainAVX512(int n, const Layer **chain, const int *kind,
+    int (*area)[4], uint64_t (*st)[LANE_CNT], uint64_t (*ss)[LANE_CNT],
+    int *buf0, int *buf1)
+{
+    runLaneChain(n, chain, kind, area, st, ss, buf0, buf1);
+}
+
+static ATTR(target("avx2"))
+void runLaneChainAVX2(int n, const Layer **chain, const int *kind,
+    int (*area)[4], uint64_t (*st)[LANE_CNT], uint64_t (*ss)[LANE_CNT],
+    int *buf0, int *buf1)
+{
+    runLaneChain(n, chain, kind, area, st, ss, buf0, buf1);
+}
+#endif
+
+static
+void runLaneChainDefault(int n, const Layer **chain, const int *kind,
+    int (*area)[4], uint64_t (*st)[LANE_CNT], uint64_t (*ss)[LANE_CNT],
+    int *buf0, int *buf1)
+{
+    runLaneChain(n, chain, kind, area, st, ss, buf0, buf1);
+}
+
+#endif // LAYER_LANE_VEC
+
+
+size_t getMinLaneCacheSize(const Layer *layer, int w, int h)
+{
+    // the scalar fallback needs the same buffer as genArea() after the output
+    size_t scalar = (size_t)w * h * LANE_CNT + getMinLayerCacheSize(layer, w, h);
+    size_t maxsiz = 0;
+
+    for (; layer; layer = layer->p)
+    {
+        if ((size_t)w * h > maxsiz)
+            maxsiz = (size_t)w * h;
+        int kind = getLaneKind(layer);
+        if (kind == LANE_ZOOM || kind == LANE_ZOOM_FUZZY)
+        {   // upper bound for any alignment of the area
+            w = (w + 1) / 2 + 1;
+            h = (h + 1) / 2 + 1;
+        }
+        else
+        {
+            int a[4] = { 0, 0, w, h };
+            getLaneParentArea(kind, a);
+            w = a[2];
+            h = a[3];
+        }
+    }
+
+    maxsiz *= 2 * LANE_CNT;
+    return maxsiz > scalar ? maxsiz : scalar;
+}
+
+int genAreaLanes(const Layer *layer, const uint64_t *seeds, int *out,
+    int x, int z, int w, int h)
+{
+    const Layer *chain[L_NUM];
+    int kind[L_NUM];
+    int area[L_NUM][4];
+    size_t maxsiz = 0;
+    int i, k, n = 0;
+
+    int a[4] = { x, z, w, h };
+    for (; layer; layer = layer->p)
+    {
+        if (n >= L_NUM)
+            return 1;
+        kind[n] = getLaneKind(layer);
+        if (kind[n] < 0 || (kind[n] == LANE_CONTINENT) != (layer->p == NULL))
+        {
+            printf("genAreaLanes(): unsupported layer at scale 1:%d\n",
+                layer->scale);
+            return 1;
+        }
+        chain[n] = layer;
+        memcpy(area[n], a, sizeof(a));
+        if ((size_t)a[2] * a[3] > maxsiz)
+            maxsiz = (size_t)a[2] * a[3];
+        getLaneParentArea(kind[n], a);
+        n++;
+    }
+
+#if LAYER_LANE_VEC
+    uint64_t st[L_NUM][LANE_CNT];
+    uint64_t ss[L_NUM][LANE_CNT];
+    for (i = 0; i < n; i++)
+    {
+        for (k = 0; k < LANE_CNT; k++)
+        {
+            st[i][k] = getStartSalt(seeds[k], chain[i]->layerSalt);
+            ss[i][k] = mcStepSeed(st[i][k], 0);
+        }
+    }
+
+    int *buf0 = out;
+    int *buf1 = out + maxsiz * LANE_CNT;
+#if LAYER_SIMD_X86
+    if (__builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl")
+        && __builtin_cpu_supports("avx512bw"))
+    {
+        runLaneChainAVX512(n, chain, kind, area, st, ss, buf0, buf1);
+        return 0;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        runLaneChainAVX2(n, chain, kind, area, st, ss, buf0, buf1);
+        return 0;
+    }
+#endif
+    runLaneChainDefault(n, chain, kind, area, st, ss, buf0, buf1);
+    return 0;
+
+#else
+    // without vector support, generate each seed with the scalar layers on a
+    // copy of the chain
+    Layer copy[L_NUM];
+    int *buf = out + (size_t)w * h * LANE_CNT;
+    for (i = 0; i < n; i++)
+    {
+        copy[i] = *chain[i];
+        if (copy[i].getMap == mapTileCached)
+        {
+            copy[i].getMap = ((const TileLayer*)copy[i].data)->map;
+            copy[i].data = NULL;
+        }
+        copy[i].p = i+1 < n ? &copy[i+1] : NULL;
+        copy[i].p2 = NULL;
+    }
+    for (k = 0; k < LANE_CNT; k++)
+    {
+        int64_t c;
+        setLayerSeed(copy, seeds[k]);
+        memset(buf, 0, sizeof(*buf) * w * h);
+        int err = copy->getMap(copy, buf, x, z, w, h);
+        if (err)
+            return err;
+        for (c = 0; c < (int64_t)w * h; c++)
+            out[c * LANE_CNT + k] = buf[c];
+    }
+    return 0;
+#endif
+}
+
+
 
@@ -121,6 +121,44 @@ STRUCT(LayerStack)
     PerlinNoise oceanRnd;
 };
 
+// Number of world seeds that the multi-seed layers process side by side.
+#define LANE_CNT    8
+
+STRUCT(TileCacheEntry)
+{
+    uint64_t seed;      // world seed of the tile
+    int tx, tz;         // tile position in units of the tile size
+    int lid;            // index of the cached layer in TileCache.lay
+    int hnext;          // next entry in the same hash bucket
+    int prev, next;     // neighbours in the usage order
+};
+
+STRUCT(TileLayer)
+{
+    struct TileCache *tc;
+    mapfunc_t *map;     // original mapping function of the layer
+    int *buf;           // buffer for generating a tile of this layer
+    uint64_t seed;      // world seed of the layer
+    int seeded;         // set once the layer has seen setLayerSeed()
+};
+
+// LRU cache of the outputs of some layers in fixed size tiles
+STRUCT(TileCache)
+{
+    uint64_t hits;      // tiles that were copied from the cache
+    uint64_t misses;    // tiles that had to be generated
+    int tsize;          // width and height of a tile in cells
+    int cap;            // maximum number of tiles
+    int cnt;            // number of tiles in use
+    int head;           // most recently used tile, or -1 if empty
+    int hmask;          // number of hash buckets minus one
+    int laycnt;
+    int *htab;
+    int *ids;           // biomes of tile i at ids[i * tsize*tsize]
+    TileCacheEntry *ent;
+    TileLayer lay[L_NUM];
+};
+
 
 #ifdef __cplusplus
 extern "C"
@@ -134,6 +172,14 @@ extern "C"
 /* Applies the given world seed to the layer and all dependent layers. */
 void setLayerSeed(Layer *layer, uint64_t worldSeed);
 
+/* Calculates the minimum size of the buffers required to generate an area of
+ * dimensions 'sizeX' by 'sizeZ' at the specified layer, for any position of
+ * the area. The size is planned from the regions that each layer of the graph
+ * uses in the buffer, such that regions that are not live at the same time
+ * share their space.
+ */
+size_t getMinLayerCacheSize(const Layer *layer, int sizeX, int sizeZ);
+
 //==============================================================================
 // Layers
 //==============================================================================
@@ -184,6 +230,64 @@ void voronoiAccess3D(uint64_t sha, int x, int y, int z, int *x4, int *y4, int *z
 void mapVoronoiPlane(uint64_t sha, int *out, int *src,
     int x, int z, int w, int h, int y, int px, int pz, int pw, int ph);
 
+//==============================================================================
+// Layer Tile Cache
+//==============================================================================
+
+/* A TileCache memoizes the output of selected layers between calls, so that
+ * overlapping or neighbouring areas do not regenerate the same cells of the
+ * parent layers again. The areas of a cached layer are assembled from square
+ * tiles of 'tsize' cells, aligned to multiples of the tile size. Each tile is
+ * keyed by its layer, position and world seed, and up to 'cap' tiles are held
+ * in a pool that is shared between the cached layers. When the pool is full,
+ * the least recently used tile is replaced. The biomes are unchanged.
+ *
+ * attachTileCache() substitutes the mapping function of a layer with
+ * mapTileCached() and uses Layer.data for the cache, so custom layers that use
+ * their 'data' cannot be cached. A layer only uses its cache after it has been
+ * seeded with setLayerSeed() while attached. Attaching or detaching a layer
+ * discards the cached tiles. The cache is not owned by the layers and should
+ * not be used by multiple threads at once. The layers have to be detached
+ * before the cache is freed.
+ *
+ * initTileCache() and attachTileCache() return zero upon success.
+ *
+ * Code that substitutes the mapping functions of a layer stack in place, such
+ * as checkForBiomesAtLayer(), would be bypassed by cached tiles and has to
+ * suspend the cached layers first. suspendTileCache() restores the original
+ * mapping functions of the cached layers of 'ls' and stores their cache state
+ * in 'saved' (L_NUM entries), which resumeTileCache() reattaches. The resumed
+ * layers use their cache again after the next setLayerSeed().
+ */
+int initTileCache(TileCache *tc, int tsize, int cap);
+void freeTileCache(TileCache *tc);
+void clearTileCache(TileCache *tc);
+int attachTileCache(TileCache *tc, Layer *l);
+void detachTileCache(Layer *l);
+void suspendTileCache(LayerStack *ls, TileLayer **saved);
+void resumeTileCache(LayerStack *ls, TileLayer **saved);
+mapfunc_t mapTileCached;
+
+//==============================================================================
+// Multi-Seed Lanes
+//==============================================================================
+
+/* Generates the area [x,z,w,h] of 'layer' for LANE_CNT world 'seeds' at once,
+ * giving the same biomes as genArea() after setLayerSeed() for each seed. The
+ * result is written to the beginning of 'out' with LANE_CNT ids per cell:
+ *  out[ (z*w + x) * LANE_CNT + k ]
+ * for seeds[k]. The buffer has to hold getMinLaneCacheSize() ints.
+ *
+ * Supported are the 1.7 - 1.17 Overworld layers up to L_BIOME_256, including
+ * L_BAMBOO_256 and L_RIVER_INIT_256. The seeds are processed in lock-step as
+ * vectors, so that the PRNG of the layers runs as SIMD operations, which use
+ * AVX2 or AVX-512 where available. Without compiler support for vectors the
+ * seeds are generated one after the other. Returns zero upon success.
+ */
+size_t getMinLaneCacheSize(const Layer *layer, int w, int h);
+int genAreaLanes(const Layer *layer, const uint64_t *seeds, int *out,
+    int x, int z, int w, int h);
+
 
 #ifdef __cplusplus
 }
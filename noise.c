@@ -3,6 +3,12 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NOISE_SIMD_X86 1
+#include <immintrin.h>
+#endif
 
 // grad()
 #if 0
@@ -106,6 +112,66 @@ void xPerlinInit(PerlinNoise *noise, Xoroshiro *xr)
     noise->t2 = d2*d2*d2 * (d2 * (d2*6.0-15.0) + 10.0);
 }
 
+/* Evaluates the eight gradient corners of a Perlin lattice cell and
+ * interpolates them. The first hash layer {a1, b1} depends only on the x and y
+ * lattice indices, which allows callers to reuse it along a z-row.
+ */
+ATTR(hot, always_inline)
+static inline double samplePerlinCorners(const uint8_t *idx,
+        uint8_t a1, uint8_t b1, uint8_t h3,
+        double d1, double d2, double d3, double t1, double t2, double t3)
+{
+#if 1
+    // try to promote optimizations that can utilize the {xh, xl} registers
+    typedef struct vec2 { uint8_t a, b; } vec2;
+
+    vec2 v2 = { idx[a1], idx[a1+1] };
+    vec2 v3 = { idx[b1], idx[b1+1] };
+    v2.a += h3;
+    v2.b += h3;
+    v3.a += h3;
+    v3.b += h3;
+
+    vec2 v4 = { idx[v2.a], idx[v2.a+1] };
+    vec2 v5 = { idx[v2.b], idx[v2.b+1] };
+    vec2 v6 = { idx[v3.a], idx[v3.a+1] };
+    vec2 v7 = { idx[v3.b], idx[v3.b+1] };
+
+    double l1 = indexedLerp(v4.a, d1,   d2,   d3);
+    double l5 = indexedLerp(v4.b, d1,   d2,   d3-1);
+    double l2 = indexedLerp(v6.a, d1-1, d2,   d3);
+    double l6 = indexedLerp(v6.b, d1-1, d2,   d3-1);
+    double l3 = indexedLerp(v5.a, d1,   d2-1, d3);
+    double l7 = indexedLerp(v5.b, d1,   d2-1, d3-1);
+    double l4 = indexedLerp(v7.a, d1-1, d2-1, d3);
+    double l8 = indexedLerp(v7.b, d1-1, d2-1, d3-1);
+#else
+    uint8_t a2 = idx[a1]   + h3;
+    uint8_t b2 = idx[b1]   + h3;
+    uint8_t a3 = idx[a1+1] + h3;
+    uint8_t b3 = idx[b1+1] + h3;
+
+    double l1 = indexedLerp(idx[a2],   d1,   d2,   d3);
+    double l2 = indexedLerp(idx[b2],   d1-1, d2,   d3);
+    double l3 = indexedLerp(idx[a3],   d1,   d2-1, d3);
+    double l4 = indexedLerp(idx[b3],   d1-1, d2-1, d3);
+    double l5 = indexedLerp(idx[a2+1], d1,   d2,   d3-1);
+    double l6 = indexedLerp(idx[b2+1], d1-1, d2,   d3-1);
+    double l7 = indexedLerp(idx[a3+1], d1,   d2-1, d3-1);
+    double l8 = indexedLerp(idx[b3+1], d1-1, d2-1, d3-1);
+#endif
+
+    l1 = lerp(t1, l1, l2);
+    l3 = lerp(t1, l3, l4);
+    l5 = lerp(t1, l5, l6);
+    l7 = lerp(t1, l7, l8);
+
+    l1 = lerp(t2, l1, l3);
+    l5 = lerp(t2, l5, l7);
+
+    return lerp(t3, l1, l5);
+}
+
 double samplePerlin(const PerlinNoise *noise, double d1, double d2, double d3,
         double yamp, double ymin)
 {
@@ -148,65 +214,436 @@ double samplePerlin(const PerlinNoise *noise, double d1, double d2, double d3,
     }
 
     const uint8_t *idx = noise->d;
+    uint8_t a1 = idx[h1]   + h2;
+    uint8_t b1 = idx[h1+1] + h2;
+    return samplePerlinCorners(idx, a1, b1, h3, d1, d2, d3, t1, t2, t3);
+}
 
-#if 1
-    // try to promote optimizations that can utilize the {xh, xl} registers
-    typedef struct vec2 { uint8_t a, b; } vec2;
+ATTR(hot, const)
+static inline float indexedLerpF(uint8_t idx, float a, float b, float c)
+{
+   switch (idx & 0xf)
+   {
+   case 0:  return  a + b;
+   case 1:  return -a + b;
+   case 2:  return  a - b;
+   case 3:  return -a - b;
+   case 4:  return  a + c;
+   case 5:  return -a + c;
+   case 6:  return  a - c;
+   case 7:  return -a - c;
+   case 8:  return  b + c;
+   case 9:  return -b + c;
+   case 10: return  b - c;
+   case 11: return -b - c;
+   case 12: return  a + b;
+   case 13: return -b + c;
+   case 14: return -a + b;
+   case 15: return -b - c;
+   }
+   UNREACHABLE();
+   return 0;
+}
 
-    vec2 v1 = { idx[h1], idx[h1+1] };
-    v1.a += h2;
-    v1.b += h2;
+static inline float lerpF(float part, float from, float to)
+{
+    return from + part * (to - from);
+}
 
-    vec2 v2 = { idx[v1.a], idx[v1.a+1] };
-    vec2 v3 = { idx[v1.b], idx[v1.b+1] };
-    v2.a += h3;
-    v2.b += h3;
-    v3.a += h3;
-    v3.b += h3;
+float samplePerlinF(const PerlinNoise *noise, double x, double y, double z)
+{
+    // The lattice cell is resolved in double precision, which keeps the
+    // fractional positions exact far away from the origin.
+    x += noise->a;
+    y += noise->b;
+    z += noise->c;
+    double i1 = floor(x);
+    double i2 = floor(y);
+    double i3 = floor(z);
+    uint8_t h1 = (int) i1;
+    uint8_t h2 = (int) i2;
+    uint8_t h3 = (int) i3;
+    float d1 = (float) (x - i1);
+    float d2 = (float) (y - i2);
+    float d3 = (float) (z - i3);
 
-    vec2 v4 = { idx[v2.a], idx[v2.a+1] };
-    vec2 v5 = { idx[v2.b], idx[v2.b+1] };
-    vec2 v6 = { idx[v3.a], idx[v3.a+1] };
-    vec2 v7 = { idx[v3.b], idx[v3.b+1] };
+    float t1 = d1*d1*d1 * (d1 * (d1*6.0F-15.0F) + 10.0F);
+    float t2 = d2*d2*d2 * (d2 * (d2*6.0F-15.0F) + 10.0F);
+    float t3 = d3*d3*d3 * (d3 * (d3*6.0F-15.0F) + 10.0F);
 
-    double l1 = indexedLerp(v4.a, d1,   d2,   d3);
-    double l5 = indexedLerp(v4.b, d1,   d2,   d3-1);
-    double l2 = indexedLerp(v6.a, d1-1, d2,   d3);
-    double l6 = indexedLerp(v6.b, d1-1, d2,   d3-1);
-    double l3 = indexedLerp(v5.a, d1,   d2-1, d3);
-    double l7 = indexedLerp(v5.b, d1,   d2-1, d3-1);
-    double l4 = indexedLerp(v7.a, d1-1, d2-1, d3);
-    double l8 = indexedLerp(v7.b, d1-1, d2-1, d3-1);
-#else
+    const uint8_t *idx = noise->d;
     uint8_t a1 = idx[h1]   + h2;
     uint8_t b1 = idx[h1+1] + h2;
-
     uint8_t a2 = idx[a1]   + h3;
     uint8_t b2 = idx[b1]   + h3;
     uint8_t a3 = idx[a1+1] + h3;
     uint8_t b3 = idx[b1+1] + h3;
 
-    double l1 = indexedLerp(idx[a2],   d1,   d2,   d3);
-    double l2 = indexedLerp(idx[b2],   d1-1, d2,   d3);
-    double l3 = indexedLerp(idx[a3],   d1,   d2-1, d3);
-    double l4 = indexedLerp(idx[b3],   d1-1, d2-1, d3);
-    double l5 = indexedLerp(idx[a2+1], d1,   d2,   d3-1);
-    double l6 = indexedLerp(idx[b2+1], d1-1, d2,   d3-1);
-    double l7 = indexedLerp(idx[a3+1], d1,   d2-1, d3-1);
-    double l8 = indexedLerp(idx[b3+1], d1-1, d2-1, d3-1);
-#endif
+    float l1 = indexedLerpF(idx[a2],   d1,   d2,   d3);
+    float l2 = indexedLerpF(idx[b2],   d1-1, d2,   d3);
+    float l3 = indexedLerpF(idx[a3],   d1,   d2-1, d3);
+    float l4 = indexedLerpF(idx[b3],   d1-1, d2-1, d3);
+    float l5 = indexedLerpF(idx[a2+1], d1,   d2,   d3-1);
+    float l6 = indexedLerpF(idx[b2+1], d1-1, d2,   d3-1);
+    float l7 = indexedLerpF(idx[a3+1], d1,   d2-1, d3-1);
+    float l8 = indexedLerpF(idx[b3+1], d1-1, d2-1, d3-1);
 
-    l1 = lerp(t1, l1, l2);
-    l3 = lerp(t1, l3, l4);
-    l5 = lerp(t1, l5, l6);
-    l7 = lerp(t1, l7, l8);
+    l1 = lerpF(t1, l1, l2);
+    l3 = lerpF(t1, l3, l4);
+    l5 = lerpF(t1, l5, l6);
+    l7 = lerpF(t1, l7, l8);
 
-    l1 = lerp(t2, l1, l3);
-    l5 = lerp(t2, l5, l7);
+    l1 = lerpF(t2, l1, l3);
+    l5 = lerpF(t2, l5, l7);
 
-    return lerp(t3, l1, l5);
+    return lerpF(t3, l1, l5);
+}
+
+#if NOISE_SIMD_X86
+/* The batched kernels reproduce samplePerlin() exactly: the same operations
+ * are performed in the same order and we do not allow fused multiply-adds.
+ * The gradient selection of indexedLerp() is encoded as bit tables over the
+ * 16 cases, each of which evaluates to (+/-)p + (+/-)q with p in {a,b} and
+ * q in {b,c}.
+ */
+enum {
+    GRAD_P_IS_A = 0x50ff,   // otherwise p = b
+    GRAD_Q_IS_B = 0x500f,   // otherwise q = c
+    GRAD_P_NEG  = 0xeaaa,
+    GRAD_Q_NEG  = 0x8ccc,
+};
+
+ATTR(target("avx2"))
+static inline __m256d gradAVX2(__m128i idx, __m256d a, __m256d b, __m256d c)
+{
+    __m256i i = _mm256_cvtepu32_epi64(_mm_and_si128(idx, _mm_set1_epi32(15)));
+    __m256i pa = _mm256_srlv_epi64(_mm256_set1_epi64x(GRAD_P_IS_A), i);
+    __m256i qb = _mm256_srlv_epi64(_mm256_set1_epi64x(GRAD_Q_IS_B), i);
+    __m256i pn = _mm256_srlv_epi64(_mm256_set1_epi64x(GRAD_P_NEG), i);
+    __m256i qn = _mm256_srlv_epi64(_mm256_set1_epi64x(GRAD_Q_NEG), i);
+    __m256d p = _mm256_blendv_pd(b, a, _mm256_castsi256_pd(_mm256_slli_epi64(pa, 63)));
+    __m256d q = _mm256_blendv_pd(c, b, _mm256_castsi256_pd(_mm256_slli_epi64(qb, 63)));
+    p = _mm256_xor_pd(p, _mm256_castsi256_pd(_mm256_slli_epi64(pn, 63)));
+    q = _mm256_xor_pd(q, _mm256_castsi256_pd(_mm256_slli_epi64(qn, 63)));
+    return _mm256_add_pd(p, q);
+}
+
+ATTR(target("avx2"))
+static inline __m256d fadeAVX2(__m256d d)
+{
+    __m256d t = _mm256_mul_pd(d, _mm256_set1_pd(6.0));
+    t = _mm256_sub_pd(t, _mm256_set1_pd(15.0));
+    t = _mm256_mul_pd(d, t);
+    t = _mm256_add_pd(t, _mm256_set1_pd(10.0));
+    return _mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(d, d), d), t);
+}
+
+ATTR(target("avx2"))
+static inline __m256d lerpAVX2(__m256d part, __m256d from, __m256d to)
+{
+    return _mm256_add_pd(from, _mm256_mul_pd(part, _mm256_sub_pd(to, from)));
+}
+
+ATTR(target("avx2"))
+static int samplePerlinBatchAVX2(const PerlinNoise *noise, double *out,
+        const double *x, const double *y, const double *z, int n)
+{
+    // A 32-bit gather at idx+h yields both idx[h] and idx[h+1] in its lower
+    // two bytes. For h=255 this reads up to idx[258], which is still inside
+    // the PerlinNoise struct (h2 and padding).
+    const int *idx = (const int*) noise->d;
+    const __m128i m8 = _mm_set1_epi32(0xff);
+    const __m256d one = _mm256_set1_pd(1.0);
+    int i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        __m256d d1 = _mm256_add_pd(_mm256_loadu_pd(x+i), _mm256_set1_pd(noise->a));
+        __m256d d2 = _mm256_add_pd(_mm256_loadu_pd(y+i), _mm256_set1_pd(noise->b));
+        __m256d d3 = _mm256_add_pd(_mm256_loadu_pd(z+i), _mm256_set1_pd(noise->c));
+        __m256d i1 = _mm256_floor_pd(d1);
+        __m256d i2 = _mm256_floor_pd(d2);
+        __m256d i3 = _mm256_floor_pd(d3);
+        d1 = _mm256_sub_pd(d1, i1);
+        d2 = _mm256_sub_pd(d2, i2);
+        d3 = _mm256_sub_pd(d3, i3);
+        __m128i h1 = _mm_and_si128(_mm256_cvttpd_epi32(i1), m8);
+        __m128i h2 = _mm256_cvttpd_epi32(i2);
+        __m128i h3 = _mm256_cvttpd_epi32(i3);
+        __m256d t1 = fadeAVX2(d1);
+        __m256d t2 = fadeAVX2(d2);
+        __m256d t3 = fadeAVX2(d3);
+
+        __m128i g, v1a, v1b, v2a, v2b, v3a, v3b, v4, v5, v6, v7;
+        g = _mm_i32gather_epi32(idx, h1, 1);
+        v1a = _mm_and_si128(_mm_add_epi32(g, h2), m8);
+        v1b = _mm_and_si128(_mm_add_epi32(_mm_srli_epi32(g, 8), h2), m8);
+        g = _mm_i32gather_epi32(idx, v1a, 1);
+        v2a = _mm_and_si128(_mm_add_epi32(g, h3), m8);
+        v2b = _mm_and_si128(_mm_add_epi32(_mm_srli_epi32(g, 8), h3), m8);
+        g = _mm_i32gather_epi32(idx, v1b, 1);
+        v3a = _mm_and_si128(_mm_add_epi32(g, h3), m8);
+        v3b = _mm_and_si128(_mm_add_epi32(_mm_srli_epi32(g, 8), h3), m8);
+        v4 = _mm_i32gather_epi32(idx, v2a, 1);
+        v5 = _mm_i32gather_epi32(idx, v2b, 1);
+        v6 = _mm_i32gather_epi32(idx, v3a, 1);
+        v7 = _mm_i32gather_epi32(idx, v3b, 1);
+
+        __m256d e1 = _mm256_sub_pd(d1, one);
+        __m256d e2 = _mm256_sub_pd(d2, one);
+        __m256d e3 = _mm256_sub_pd(d3, one);
+        __m256d l1 = gradAVX2(v4, d1, d2, d3);
+        __m256d l5 = gradAVX2(_mm_srli_epi32(v4, 8), d1, d2, e3);
+        __m256d l2 = gradAVX2(v6, e1, d2, d3);
+        __m256d l6 = gradAVX2(_mm_srli_epi32(v6, 8), e1, d2, e3);
+        __m256d l3 = gradAVX2(v5, d1, e2, d3);
+        __m256d l7 = gradAVX2(_mm_srli_epi32(v5, 8), d1, e2, e3);
+        __m256d l4 = gradAVX2(v7, e1, e2, d3);
+        __m256d l8 = gradAVX2(_mm_srli_epi32(v7, 8), e1, e2, e3);
+
+        l1 = lerpAVX2(t1, l1, l2);
+        l3 = lerpAVX2(t1, l3, l4);
+        l5 = lerpAVX2(t1, l5, l6);
+        l7 = lerpAVX2(t1, l7, l8);
+        l1 = lerpAVX2(t2, l1, l3);
+        l5 = lerpAVX2(t2, l5, l7);
+        _mm256_storeu_pd(out+i, lerpAVX2(t3, l1, l5));
+    }
+    return i;
+}
+
+ATTR(target("sse4.1"))
+static inline __m128d gradSSE41(const uint8_t v[2],
+        __m128d a, __m128d b, __m128d c)
+{
+    int i0 = v[0] & 15, i1 = v[1] & 15;
+    __m128i pa = _mm_set_epi64x((uint64_t)(GRAD_P_IS_A >> i1) << 63, (uint64_t)(GRAD_P_IS_A >> i0) << 63);
+    __m128i qb = _mm_set_epi64x((uint64_t)(GRAD_Q_IS_B >> i1) << 63, (uint64_t)(GRAD_Q_IS_B >> i0) << 63);
+    __m128i pn = _mm_set_epi64x((uint64_t)(GRAD_P_NEG  >> i1) << 63, (uint64_t)(GRAD_P_NEG  >> i0) << 63);
+    __m128i qn = _mm_set_epi64x((uint64_t)(GRAD_Q_NEG  >> i1) << 63, (uint64_t)(GRAD_Q_NEG  >> i0) << 63);
+    __m128d p = _mm_blendv_pd(b, a, _mm_castsi128_pd(pa));
+    __m128d q = _mm_blendv_pd(c, b, _mm_castsi128_pd(qb));
+    p = _mm_xor_pd(p, _mm_castsi128_pd(pn));
+    q = _mm_xor_pd(q, _mm_castsi128_pd(qn));
+    return _mm_add_pd(p, q);
+}
+
+ATTR(target("sse4.1"))
+static inline __m128d fadeSSE41(__m128d d)
+{
+    __m128d t = _mm_mul_pd(d, _mm_set1_pd(6.0));
+    t = _mm_sub_pd(t, _mm_set1_pd(15.0));
+    t = _mm_mul_pd(d, t);
+    t = _mm_add_pd(t, _mm_set1_pd(10.0));
+    return _mm_mul_pd(_mm_mul_pd(_mm_mul_pd(d, d), d), t);
 }
 
+ATTR(target("sse4.1"))
+static inline __m128d lerpSSE41(__m128d part, __m128d from, __m128d to)
+{
+    return _mm_add_pd(from, _mm_mul_pd(part, _mm_sub_pd(to, from)));
+}
+
+ATTR(target("sse4.1"))
+static int samplePerlinBatchSSE41(const PerlinNoise *noise, double *out,
+        const double *x, const double *y, const double *z, int n)
+{
+    const uint8_t *idx = noise->d;
+    const __m128d one = _mm_set1_pd(1.0);
+    int i, k;
+
+    for (i = 0; i + 2 <= n; i += 2)
+    {
+        __m128d d1 = _mm_add_pd(_mm_loadu_pd(x+i), _mm_set1_pd(noise->a));
+        __m128d d2 = _mm_add_pd(_mm_loadu_pd(y+i), _mm_set1_pd(noise->b));
+        __m128d d3 = _mm_add_pd(_mm_loadu_pd(z+i), _mm_set1_pd(noise->c));
+        __m128d i1 = _mm_floor_pd(d1);
+        __m128d i2 = _mm_floor_pd(d2);
+        __m128d i3 = _mm_floor_pd(d3);
+        d1 = _mm_sub_pd(d1, i1);
+        d2 = _mm_sub_pd(d2, i2);
+        d3 = _mm_sub_pd(d3, i3);
+
+        int32_t h[3][4];
+        _mm_storeu_si128((__m128i*) h[0], _mm_cvttpd_epi32(i1));
+        _mm_storeu_si128((__m128i*) h[1], _mm_cvttpd_epi32(i2));
+        _mm_storeu_si128((__m128i*) h[2], _mm_cvttpd_epi32(i3));
+
+        // permutation lookups, with lane k in element k of each array
+        uint8_t v4a[2], v4b[2], v5a[2], v5b[2], v6a[2], v6b[2], v7a[2], v7b[2];
+        for (k = 0; k < 2; k++)
+        {
+            uint8_t h1 = h[0][k], h2 = h[1][k], h3 = h[2][k];
+            uint8_t a1 = idx[h1] + h2, b1 = idx[h1+1] + h2;
+            uint8_t a2 = idx[a1] + h3, b2 = idx[a1+1] + h3;
+            uint8_t a3 = idx[b1] + h3, b3 = idx[b1+1] + h3;
+            v4a[k] = idx[a2]; v4b[k] = idx[a2+1];
+            v5a[k] = idx[b2]; v5b[k] = idx[b2+1];
+            v6a[k] = idx[a3]; v6b[k] = idx[a3+1];
+            v7a[k] = idx[b3]; v7b[k] = idx[b3+1];
+        }
+
+        __m128d t1 = fadeSSE41(d1);
+        __m128d t2 = fadeSSE41(d2);
+        __m128d t3 = fadeSSE41(d3);
+        __m128d e1 = _mm_sub_pd(d1, one);
+        __m128d e2 = _mm_sub_pd(d2, one);
+        __m128d e3 = _mm_sub_pd(d3, one);
+        __m128d l1 = gradSSE41(v4a, d1, d2, d3);
+        __m128d l5 = gradSSE41(v4b, d1, d2, e3);
+        __m128d l2 = gradSSE41(v6a, e1, d2, d3);
+        __m128d l6 = gradSSE41(v6b, e1, d2, e3);
+        __m128d l3 = gradSSE41(v5a, d1, e2, d3);
+        __m128d l7 = gradSSE41(v5b, d1, e2, e3);
+        __m128d l4 = gradSSE41(v7a, e1, e2, d3);
+        __m128d l8 = gradSSE41(v7b, e1, e2, e3);
+
+        l1 = lerpSSE41(t1, l1, l2);
+        l3 = lerpSSE41(t1, l3, l4);
+        l5 = lerpSSE41(t1, l5, l6);
+        l7 = lerpSSE41(t1, l7, l8);
+        l1 = lerpSSE41(t2, l1, l3);
+        l5 = lerpSSE41(t2, l5, l7);
+        _mm_storeu_pd(out+i, lerpSSE41(t3, l1, l5));
+    }
+    return i;
+}
+
+/* The float32 kernel has eight lanes. The lattice cells are still resolved in
+ * double precision, and only the fractional positions are converted to floats.
+ */
+ATTR(target("avx2"))
+static inline __m256 gradAVX2F(__m256i idx, __m256 a, __m256 b, __m256 c)
+{
+    __m256i i = _mm256_and_si256(idx, _mm256_set1_epi32(15));
+    __m256i pa = _mm256_srlv_epi32(_mm256_set1_epi32(GRAD_P_IS_A), i);
+    __m256i qb = _mm256_srlv_epi32(_mm256_set1_epi32(GRAD_Q_IS_B), i);
+    __m256i pn = _mm256_srlv_epi32(_mm256_set1_epi32(GRAD_P_NEG), i);
+    __m256i qn = _mm256_srlv_epi32(_mm256_set1_epi32(GRAD_Q_NEG), i);
+    __m256 p = _mm256_blendv_ps(b, a, _mm256_castsi256_ps(_mm256_slli_epi32(pa, 31)));
+    __m256 q = _mm256_blendv_ps(c, b, _mm256_castsi256_ps(_mm256_slli_epi32(qb, 31)));
+    p = _mm256_xor_ps(p, _mm256_castsi256_ps(_mm256_slli_epi32(pn, 31)));
+    q = _mm256_xor_ps(q, _mm256_castsi256_ps(_mm256_slli_epi32(qn, 31)));
+    return _mm256_add_ps(p, q);
+}
+
+ATTR(target("avx2"))
+static inline __m256 fadeAVX2F(__m256 d)
+{
+    __m256 t = _mm256_mul_ps(d, _mm256_set1_ps(6.0F));
+    t = _mm256_sub_ps(t, _mm256_set1_ps(15.0F));
+    t = _mm256_mul_ps(d, t);
+    t = _mm256_add_ps(t, _mm256_set1_ps(10.0F));
+    return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(d, d), d), t);
+}
+
+ATTR(target("avx2"))
+static inline __m256 lerpAVX2F(__m256 part, __m256 from, __m256 to)
+{
+    return _mm256_add_ps(from, _mm256_mul_ps(part, _mm256_sub_ps(to, from)));
+}
+
+/// Splits eight coordinates into lattice indices and float fractions.
+ATTR(target("avx2"))
+static inline __m256 latticeAVX2F(const double *p, double off, __m256i *h)
+{
+    __m256d lo = _mm256_add_pd(_mm256_loadu_pd(p), _mm256_set1_pd(off));
+    __m256d hi = _mm256_add_pd(_mm256_loadu_pd(p+4), _mm256_set1_pd(off));
+    __m256d ilo = _mm256_floor_pd(lo);
+    __m256d ihi = _mm256_floor_pd(hi);
+    *h = _mm256_inserti128_si256(_mm256_castsi128_si256(
+        _mm256_cvttpd_epi32(ilo)), _mm256_cvttpd_epi32(ihi), 1);
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(
+        _mm256_cvtpd_ps(_mm256_sub_pd(lo, ilo))),
+        _mm256_cvtpd_ps(_mm256_sub_pd(hi, ihi)), 1);
+}
+
+ATTR(target("avx2"))
+static int samplePerlinBatchAVX2F(const PerlinNoise *noise, float *out,
+        const double *x, const double *y, const double *z, int n)
+{
+    const int *idx = (const int*) noise->d;
+    const __m256i m8 = _mm256_set1_epi32(0xff);
+    const __m256 one = _mm256_set1_ps(1.0F);
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        __m256i h1, h2, h3;
+        __m256 d1 = latticeAVX2F(x+i, noise->a, &h1);
+        __m256 d2 = latticeAVX2F(y+i, noise->b, &h2);
+        __m256 d3 = latticeAVX2F(z+i, noise->c, &h3);
+        h1 = _mm256_and_si256(h1, m8);
+        __m256 t1 = fadeAVX2F(d1);
+        __m256 t2 = fadeAVX2F(d2);
+        __m256 t3 = fadeAVX2F(d3);
+
+        __m256i g, v1a, v1b, v2a, v2b, v3a, v3b, v4, v5, v6, v7;
+        g = _mm256_i32gather_epi32(idx, h1, 1);
+        v1a = _mm256_and_si256(_mm256_add_epi32(g, h2), m8);
+        v1b = _mm256_and_si256(_mm256_add_epi32(_mm256_srli_epi32(g, 8), h2), m8);
+        g = _mm256_i32gather_epi32(idx, v1a, 1);
+        v2a = _mm256_and_si256(_mm256_add_epi32(g, h3), m8);
+        v2b = _mm256_and_si256(_mm256_add_epi32(_mm256_srli_epi32(g, 8), h3), m8);
+        g = _mm256_i32gather_epi32(idx, v1b, 1);
+        v3a = _mm256_and_si256(_mm256_add_epi32(g, h3), m8);
+        v3b = _mm256_and_si256(_mm256_add_epi32(_mm256_srli_epi32(g, 8), h3), m8);
+        v4 = _mm256_i32gather_epi32(idx, v2a, 1);
+        v5 = _mm256_i32gather_epi32(idx, v2b, 1);
+        v6 = _mm256_i32gather_epi32(idx, v3a, 1);
+        v7 = _mm256_i32gather_epi32(idx, v3b, 1);
+
+        __m256 e1 = _mm256_sub_ps(d1, one);
+        __m256 e2 = _mm256_sub_ps(d2, one);
+        __m256 e3 = _mm256_sub_ps(d3, one);
+        __m256 l1 = gradAVX2F(v4, d1, d2, d3);
+        __m256 l5 = gradAVX2F(_mm256_srli_epi32(v4, 8), d1, d2, e3);
+        __m256 l2 = gradAVX2F(v6, e1, d2, d3);
+        __m256 l6 = gradAVX2F(_mm256_srli_epi32(v6, 8), e1, d2, e3);
+        __m256 l3 = gradAVX2F(v5, d1, e2, d3);
+        __m256 l7 = gradAVX2F(_mm256_srli_epi32(v5, 8), d1, e2, e3);
+        __m256 l4 = gradAVX2F(v7, e1, e2, d3);
+        __m256 l8 = gradAVX2F(_mm256_srli_epi32(v7, 8), e1, e2, e3);
+
+        l1 = lerpAVX2F(t1, l1, l2);
+        l3 = lerpAVX2F(t1, l3, l4);
+        l5 = lerpAVX2F(t1, l5, l6);
+        l7 = lerpAVX2F(t1, l7, l8);
+        l1 = lerpAVX2F(t2, l1, l3);
+        l5 = lerpAVX2F(t2, l5, l7);
+        _mm256_storeu_ps(out+i, lerpAVX2F(t3, l1, l5));
+    }
+    return i;
+}
+#endif // NOISE_SIMD_X86
+
+void samplePerlinBatch(const PerlinNoise *noise, double *out,
+        const double *x, const double *y, const double *z, int n)
+{
+    int i = 0;
+#if NOISE_SIMD_X86
+    if (__builtin_cpu_supports("avx2"))
+        i = samplePerlinBatchAVX2(noise, out, x, y, z, n);
+    else if (__builtin_cpu_supports("sse4.1"))
+        i = samplePerlinBatchSSE41(noise, out, x, y, z, n);
+#endif
+    for (; i < n; i++)
+        out[i] = samplePerlin(noise, x[i], y[i], z[i], 0, 0);
+}
+
+void samplePerlinBatchF(const PerlinNoise *noise, float *out,
+        const double *x, const double *y, const double *z, int n)
+{
+    int i = 0;
+#if NOISE_SIMD_X86
+    if (__builtin_cpu_supports("avx2"))
+        i = samplePerlinBatchAVX2F(noise, out, x, y, z, n);
+#endif
+    for (; i < n; i++)
+        out[i] = samplePerlinF(noise, x[i], y[i], z[i]);
+}
+
+
 static
 void samplePerlinBeta17Terrain(const PerlinNoise *noise, double *v,
         double d1, double d3, double yLacAmp)
@@ -258,13 +695,15 @@ void samplePerlinBeta17Terrain(const PerlinNoise *noise, double *v,
         if (yi == 0 || i2 != genFlag)
         {
             genFlag = i2;
-            int a1 = idx[i1]   + i2;
-            int b1 = idx[i1+1] + i2;
+            // the permutation wraps around at 256 (as the array of size 512
+            // in the original), which the uint8_t arithmetic takes care of
+            uint8_t a1 = idx[i1]   + i2;
+            uint8_t b1 = idx[i1+1] + i2;
 
-            int a2 = idx[a1]   + i3;
-            int a3 = idx[a1+1] + i3;
-            int b2 = idx[b1]   + i3;
-            int b3 = idx[b1+1] + i3;
+            uint8_t a2 = idx[a1]   + i3;
+            uint8_t a3 = idx[a1+1] + i3;
+            uint8_t b2 = idx[b1]   + i3;
+            uint8_t b3 = idx[b1+1] + i3;
 
             double m1 = indexedLerp(idx[a2],   d1,   d2,   d3);
             double l2 = indexedLerp(idx[b2],   d1-1, d2,   d3);
@@ -481,6 +920,78 @@ double sampleOctave(const OctaveNoise *noise, double x, double y, double z)
     return v;
 }
 
+void sampleOctaveBatch(const OctaveNoise *noise, double *out,
+        const double *x, const double *y, const double *z, int n)
+{
+    enum { CHUNK = 64 };
+    double ax[CHUNK], ay[CHUNK], az[CHUNK], pv[CHUNK];
+    int i, j, k, m;
+    for (i = 0; i < n; i += m)
+    {
+        m = n - i < CHUNK ? n - i : CHUNK;
+        for (j = 0; j < m; j++)
+            out[i+j] = 0;
+        for (k = 0; k < noise->octcnt; k++)
+        {
+            PerlinNoise *p = noise->octaves + k;
+            double lf = p->lacunarity;
+            for (j = 0; j < m; j++)
+            {
+                ax[j] = maintainPrecision(x[i+j] * lf);
+                ay[j] = maintainPrecision(y[i+j] * lf);
+                az[j] = maintainPrecision(z[i+j] * lf);
+            }
+            samplePerlinBatch(p, pv, ax, ay, az, m);
+            for (j = 0; j < m; j++)
+                out[i+j] += p->amplitude * pv[j];
+        }
+    }
+}
+
+float sampleOctaveF(const OctaveNoise *noise, double x, double y, double z)
+{
+    float v = 0;
+    int i;
+    for (i = 0; i < noise->octcnt; i++)
+    {
+        PerlinNoise *p = noise->octaves + i;
+        double lf = p->lacunarity;
+        float pv = samplePerlinF(p, x * lf, y * lf, z * lf);
+        v += (float) p->amplitude * pv;
+    }
+    return v;
+}
+
+void sampleOctaveBatchF(const OctaveNoise *noise, float *out,
+        const double *x, const double *y, const double *z, int n)
+{
+    enum { CHUNK = 64 };
+    double ax[CHUNK], ay[CHUNK], az[CHUNK];
+    float pv[CHUNK];
+    int i, j, k, m;
+    for (i = 0; i < n; i += m)
+    {
+        m = n - i < CHUNK ? n - i : CHUNK;
+        for (j = 0; j < m; j++)
+            out[i+j] = 0;
+        for (k = 0; k < noise->octcnt; k++)
+        {
+            PerlinNoise *p = noise->octaves + k;
+            double lf = p->lacunarity;
+            float amp = (float) p->amplitude;
+            for (j = 0; j < m; j++)
+            {
+                ax[j] = x[i+j] * lf;
+                ay[j] = y[i+j] * lf;
+                az[j] = z[i+j] * lf;
+            }
+            samplePerlinBatchF(p, pv, ax, ay, az, m);
+            for (j = 0; j < m; j++)
+                out[i+j] += amp * pv[j];
+        }
+    }
+}
+
 double sampleOctaveBeta17Biome(const OctaveNoise *noise, double x, double z)
 {
     double v = 0;
@@ -571,3 +1082,229 @@ double sampleDoublePerlin(const DoublePerlinNoise *noise,
     return v * noise->amplitude;
 }
 
+void sampleDoublePerlinBatch(const DoublePerlinNoise *noise, double *out,
+        const double *x, const double *y, const double *z, int n)
+{
+    enum { CHUNK = 64 };
+    const double f = 337.0 / 331.0;
+    double fx[CHUNK], fy[CHUNK], fz[CHUNK], va[CHUNK], vb[CHUNK];
+    int i, j, m;
+    for (i = 0; i < n; i += m)
+    {
+        m = n - i < CHUNK ? n - i : CHUNK;
+        for (j = 0; j < m; j++)
+        {
+            fx[j] = x[i+j] * f;
+            fy[j] = y[i+j] * f;
+            fz[j] = z[i+j] * f;
+        }
+        sampleOctaveBatch(&noise->octA, va, x+i, y+i, z+i, m);
+        sampleOctaveBatch(&noise->octB, vb, fx, fy, fz, m);
+        for (j = 0; j < m; j++)
+        {
+            double v = 0;
+            v += va[j];
+            v += vb[j];
+            out[i+j] = v * noise->amplitude;
+        }
+    }
+}
+
+float sampleDoublePerlinF(const DoublePerlinNoise *noise,
+        double x, double y, double z)
+{
+    const double f = 337.0 / 331.0;
+    float v = 0;
+
+    v += sampleOctaveF(&noise->octA, x, y, z);
+    v += sampleOctaveF(&noise->octB, x*f, y*f, z*f);
+
+    return v * (float) noise->amplitude;
+}
+
+void sampleDoublePerlinBatchF(const DoublePerlinNoise *noise, float *out,
+        const double *x, const double *y, const double *z, int n)
+{
+    enum { CHUNK = 64 };
+    const double f = 337.0 / 331.0;
+    double fx[CHUNK], fy[CHUNK], fz[CHUNK];
+    float va[CHUNK], vb[CHUNK];
+    int i, j, m;
+    for (i = 0; i < n; i += m)
+    {
+        m = n - i < CHUNK ? n - i : CHUNK;
+        for (j = 0; j < m; j++)
+        {
+            fx[j] = x[i+j] * f;
+            fy[j] = y[i+j] * f;
+            fz[j] = z[i+j] * f;
+        }
+        sampleOctaveBatchF(&noise->octA, va, x+i, y+i, z+i, m);
+        sampleOctaveBatchF(&noise->octB, vb, fx, fy, fz, m);
+        for (j = 0; j < m; j++)
+            out[i+j] = (va[j] + vb[j]) * (float) noise->amplitude;
+    }
+}
+
+void sampleDoublePerlinGrid(const DoublePerlinNoise *noise, double *out,
+        double x0, double y, double z0, double dx, double dz, int sx, int sz)
+{
+    // lattice terms along the x-axis, per octave
+    typedef struct { double d, t; uint8_t a, b; } xterm_t;
+    // terms of the y-axis, per octave
+    typedef struct { double d, t; } yterm_t;
+
+    const double f = 337.0 / 331.0;
+    const OctaveNoise *oct[2] = { &noise->octA, &noise->octB };
+    const double fac[2] = { 1.0, f };
+    int cnt = oct[0]->octcnt + oct[1]->octcnt;
+    xterm_t *xt = (xterm_t*) malloc(sizeof(*xt) * sx * cnt);
+    yterm_t *yt = (yterm_t*) malloc(sizeof(*yt) * cnt);
+    double *acc = (double*) malloc(sizeof(*acc) * sx);
+    int i, j, k, n, o;
+
+    for (o = 0, n = 0; o < 2; o++)
+    {
+        double fy = y * fac[o]; // exact for fac[0] = 1
+        for (k = 0; k < oct[o]->octcnt; k++, n++)
+        {
+            const PerlinNoise *p = oct[o]->octaves + k;
+            double lf = p->lacunarity;
+            double d2 = maintainPrecision(fy * lf) + p->b;
+            double i2 = floor(d2);
+            d2 -= i2;
+            uint8_t h2 = (int) i2;
+            yt[n].d = d2;
+            yt[n].t = d2*d2*d2 * (d2 * (d2*6.0-15.0) + 10.0);
+
+            xterm_t *x = xt + (size_t)n * sx;
+            for (i = 0; i < sx; i++)
+            {
+                double xi = x0 + i*dx;
+                double d1 = maintainPrecision(xi * fac[o] * lf) + p->a;
+                double i1 = floor(d1);
+                d1 -= i1;
+                uint8_t h1 = (int) i1;
+                x[i].d = d1;
+                x[i].t = d1*d1*d1 * (d1 * (d1*6.0-15.0) + 10.0);
+                x[i].a = p->d[h1]   + h2;
+                x[i].b = p->d[h1+1] + h2;
+            }
+        }
+    }
+
+    for (j = 0; j < sz; j++)
+    {
+        double zj = z0 + j*dz;
+        double *row = out + (size_t)j * sx;
+
+        for (o = 0, n = 0; o < 2; o++)
+        {
+            // accumulate the octaves separately, as in sampleOctave()
+            double *v = o ? acc : row;
+            double fz = zj * fac[o];
+            for (i = 0; i < sx; i++)
+                v[i] = 0;
+
+            for (k = 0; k < oct[o]->octcnt; k++, n++)
+            {
+                const PerlinNoise *p = oct[o]->octaves + k;
+                double d3 = maintainPrecision(fz * p->lacunarity) + p->c;
+                double i3 = floor(d3);
+                d3 -= i3;
+                uint8_t h3 = (int) i3;
+                double t3 = d3*d3*d3 * (d3 * (d3*6.0-15.0) + 10.0);
+                double d2 = yt[n].d, t2 = yt[n].t;
+                const xterm_t *x = xt + (size_t)n * sx;
+
+                for (i = 0; i < sx; i++)
+                {
+                    double pv = samplePerlinCorners(p->d, x[i].a, x[i].b, h3,
+                        x[i].d, d2, d3, x[i].t, t2, t3);
+                    v[i] += p->amplitude * pv;
+                }
+            }
+        }
+
+        for (i = 0; i < sx; i++)
+        {
+            double v = 0;
+            v += row[i];
+            v += acc[i];
+            row[i] = v * noise->amplitude;
+        }
+    }
+
+    free(acc);
+    free(yt);
+    free(xt);
+}
+
+
+double getOctaveTail(const OctaveNoise *noise, int start)
+{
+    double amp = 0;
+    int i;
+    for (i = start; i < noise->octcnt; i++)
+        amp += fabs(noise->octaves[i].amplitude);
+    return amp * PERLIN_MAX;
+}
+
+void initDoublePerlinPartial(DoublePerlinPartial *pp,
+        double x, double y, double z)
+{
+    pp->x = x;
+    pp->y = y;
+    pp->z = z;
+    pp->va = pp->vb = 0;
+    pp->ia = pp->ib = 0;
+}
+
+int refineDoublePerlin(const DoublePerlinNoise *noise, DoublePerlinPartial *pp)
+{
+    const double f = 337.0 / 331.0;
+    const OctaveNoise *oa = &noise->octA, *ob = &noise->octB;
+    int ra = oa->octcnt - pp->ia;
+    int rb = ob->octcnt - pp->ib;
+    if (ra <= 0 && rb <= 0)
+        return 0;
+
+    // each octave noise is summed in its own order, which keeps the final
+    // value bit-identical to sampleDoublePerlin()
+    int useb = ra <= 0 || (rb > 0 &&
+        fabs(ob->octaves[pp->ib].amplitude) > fabs(oa->octaves[pp->ia].amplitude));
+    const PerlinNoise *p;
+    double x = pp->x, y = pp->y, z = pp->z;
+    if (useb)
+    {
+        p = ob->octaves + pp->ib++;
+        x *= f; y *= f; z *= f;
+    }
+    else
+    {
+        p = oa->octaves + pp->ia++;
+    }
+    double lf = p->lacunarity;
+    double ax = maintainPrecision(x * lf);
+    double ay = maintainPrecision(y * lf);
+    double az = maintainPrecision(z * lf);
+    double pv = samplePerlin(p, ax, ay, az, 0, 0);
+    if (useb)
+        pp->vb += p->amplitude * pv;
+    else
+        pp->va += p->amplitude * pv;
+    return ra + rb - 1;
+}
+
+double getDoublePerlinPartial(const DoublePerlinNoise *noise,
+        const DoublePerlinPartial *pp, double *err)
+{
+    if (err)
+    {
+        double tail = getOctaveTail(&noise->octA, pp->ia) +
+            getOctaveTail(&noise->octB, pp->ib);
+        // the margin covers the rounding of the remaining additions
+        *err = tail > 0 ? (tail + 1e-9) * noise->amplitude : 0;
+    }
+    return (pp->va + pp->vb) * noise->amplitude;
+}
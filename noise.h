@@ -28,6 +28,17 @@ STRUCT(DoublePerlinNoise)
     OctaveNoise octB;
 };
 
+/// Bound on the magnitude of samplePerlin(), which peaks at about 1.0364.
+#define PERLIN_MAX 1.04
+
+/// Partial sum of a DoublePerlinNoise (see refineDoublePerlin()).
+STRUCT(DoublePerlinPartial)
+{
+    double x, y, z;
+    double va, vb;  // partial sums of octA and octB
+    int ia, ib;     // number of sampled octaves of octA and octB
+};
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -52,6 +63,28 @@ double samplePerlin(const PerlinNoise *noise, double x, double y, double z,
         double yamp, double ymin);
 double sampleSimplex2D(const PerlinNoise *noise, double x, double y);
 
+/**
+ * Batched sampling of 'n' points given by the coordinate arrays x, y, z.
+ * The results are written to out[i] and are bit-identical to the respective
+ * single point functions (with yamp = ymin = 0 for samplePerlin). On x86 the
+ * Perlin sampling uses AVX2 or SSE4.1 when the CPU supports it.
+ */
+void samplePerlinBatch(const PerlinNoise *noise, double *out,
+        const double *x, const double *y, const double *z, int n);
+
+/**
+ * Reduced precision (float32) variants of the samplers, for callers that can
+ * tolerate small deviations, such as previews or coarse pre-filters. The
+ * lattice cells are still resolved in double precision, so the error does not
+ * grow with the distance from the origin, but the interpolation is performed
+ * on floats, with eight lanes per AVX2 vector in the batched functions. The
+ * results differ from the double precision samplers by roughly 1e-6 relative
+ * to the noise amplitude.
+ */
+float samplePerlinF(const PerlinNoise *noise, double x, double y, double z);
+void samplePerlinBatchF(const PerlinNoise *noise, float *out,
+        const double *x, const double *y, const double *z, int n);
+
 /// Perlin Octaves
 void octaveInit(OctaveNoise *noise, uint64_t *seed, PerlinNoise *octaves,
         int omin, int len);
@@ -61,6 +94,11 @@ int xOctaveInit(OctaveNoise *noise, Xoroshiro *xr, PerlinNoise *octaves,
         const double *amplitudes, int omin, int len, int nmax);
 
 double sampleOctave(const OctaveNoise *noise, double x, double y, double z);
+void sampleOctaveBatch(const OctaveNoise *noise, double *out,
+        const double *x, const double *y, const double *z, int n);
+float sampleOctaveF(const OctaveNoise *noise, double x, double y, double z);
+void sampleOctaveBatchF(const OctaveNoise *noise, float *out,
+        const double *x, const double *y, const double *z, int n);
 double sampleOctaveAmp(const OctaveNoise *noise, double x, double y, double z,
         double yamp, double ymin, int ydefault);
 double sampleOctave2D(const OctaveNoise *noise, double x, double z);
@@ -76,6 +114,43 @@ int xDoublePerlinInit(DoublePerlinNoise *noise, Xoroshiro *xr,
 
 double sampleDoublePerlin(const DoublePerlinNoise *noise,
         double x, double y, double z);
+void sampleDoublePerlinBatch(const DoublePerlinNoise *noise, double *out,
+        const double *x, const double *y, const double *z, int n);
+float sampleDoublePerlinF(const DoublePerlinNoise *noise,
+        double x, double y, double z);
+void sampleDoublePerlinBatchF(const DoublePerlinNoise *noise, float *out,
+        const double *x, const double *y, const double *z, int n);
+
+/**
+ * Samples a regular (sx * sz) lattice at a fixed height 'y', such that
+ *  out[j*sx + i] = sampleDoublePerlin(noise, x0 + i*dx, y, z0 + j*dz)
+ * with bit-identical results. The lattice indices and fade weights of the x-
+ * and y-axis are evaluated only once per octave, and the z-terms once per row.
+ * Volumes can be sampled as a sequence of such planes.
+ */
+void sampleDoublePerlinGrid(const DoublePerlinNoise *noise, double *out,
+        double x0, double y, double z0, double dx, double dz, int sx, int sz);
+
+/**
+ * Gets a bound on the magnitude of the sum over the octaves [start, octcnt)
+ * of an OctaveNoise, i.e. on the error of truncating it to 'start' octaves.
+ */
+double getOctaveTail(const OctaveNoise *noise, int start);
+
+/**
+ * Progressive sampling of a DoublePerlinNoise. initDoublePerlinPartial() sets
+ * up an empty sum for a position, and each refineDoublePerlin() adds the next
+ * octave, taking the more significant of the two octave noises first, and
+ * returns the number of octaves that remain.
+ * getDoublePerlinPartial() returns the partial value 'v' and writes a bound
+ * 'err' such that the full value lies within [v - err, v + err]. Once all the
+ * octaves are sampled, err = 0 and 'v' is bit-identical to sampleDoublePerlin().
+ */
+void initDoublePerlinPartial(DoublePerlinPartial *pp,
+        double x, double y, double z);
+int refineDoublePerlin(const DoublePerlinNoise *noise, DoublePerlinPartial *pp);
+double getDoublePerlinPartial(const DoublePerlinNoise *noise,
+        const DoublePerlinPartial *pp, double *err);
 
 
 #ifdef __cplusplus
@@ -0,0 +1,455 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L // for clock_gettime()
+#endif
+
+#include "pipeline.h"
+#include "finders.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+
+// number of input seeds per task, which is also the batch size of the stages
+#define PIPE_CHUNK      1024
+// number of tasks per worker between the updates of the stage order
+#define PIPE_WINDOW     8
+// weight of the estimated pass rate, in seeds, against the observed rate
+#define PIPE_PRIOR      256.0
+// number of tests after which the measured costs replace the estimates
+#define PIPE_MEASURED   4096
+
+STRUCT(stage_t)
+{
+    seedstage_t *check;
+    void *data;
+    int bits;
+    int dim;
+    double cost;
+    double pass;
+    double rank;
+
+    // statistics
+    uint64_t tested;
+    uint64_t passed;
+    double secs;
+};
+
+STRUCT(stagestat_t)
+{
+    uint64_t tested;
+    uint64_t passed;
+    double secs;
+};
+
+STRUCT(pipeworker_t)
+{
+    Generator g;
+    int gdim;
+    uint64_t gseed;
+    int gvalid;
+    uint64_t buf[PIPE_CHUNK];
+    uint64_t exp[PIPE_CHUNK];
+    stagestat_t *stats;
+};
+
+STRUCT(seedlist_t)
+{
+    uint64_t *seeds;
+    size_t len, cap;
+};
+
+struct SeedPipeline
+{
+    int mc;
+    uint32_t flags;
+
+    stage_t *stages;
+    int *order;         // stage order, with the 48-bit stages first
+    int stagecnt;
+    int stagecap;
+    int cnt48;          // number of 48-bit stages
+
+    pipeworker_t **workers; // separate allocations, as the generators hold
+    int workercnt;          // pointers into themselves
+};
+
+STRUCT(piperun_t)
+{
+    SeedPipeline *sp;
+    const uint64_t *seeds;
+    uint64_t n;
+    int inbits;
+    uint64_t first;     // first chunk of the current window
+    seedlist_t *out;    // output of each task in the window
+};
+
+
+static double getTime(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER f, t;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&t);
+    return (double) t.QuadPart / f.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+SeedPipeline *createSeedPipeline(int mc, uint32_t flags)
+{
+    SeedPipeline *sp = (SeedPipeline*) calloc(1, sizeof(SeedPipeline));
+    if (!sp)
+        return NULL;
+    sp->mc = mc;
+    sp->flags = flags;
+    return sp;
+}
+
+void freeSeedPipeline(SeedPipeline *sp)
+{
+    if (!sp)
+        return;
+    int i;
+    for (i = 0; i < sp->workercnt; i++)
+    {
+        free(sp->workers[i]->stats);
+        free(sp->workers[i]);
+    }
+    free(sp->workers);
+    free(sp->stages);
+    free(sp->order);
+    free(sp);
+}
+
+/* Ranks a stage by its cost per rejected seed, where the observed pass rate is
+ * weighted against the estimate, and the measured cost is used once all stages
+ * of the group have been tested often enough to be compared.
+ */
+static double getStageRank(const stage_t *st, int measured)
+{
+    double pass = (st->passed + PIPE_PRIOR * st->pass) / (st->tested + PIPE_PRIOR);
+    double cost = measured ? st->secs / st->tested : st->cost;
+    if (pass > 0.999999)
+        pass = 0.999999;
+    return cost / (1.0 - pass);
+}
+
+static void sortStageGroup(SeedPipeline *sp, int *order, int n)
+{
+    int i, j, measured = 1;
+    for (i = 0; i < n; i++)
+        if (sp->stages[order[i]].tested < PIPE_MEASURED)
+            measured = 0;
+
+    for (i = 0; i < n; i++)
+    {
+        stage_t *st = sp->stages + order[i];
+        st->rank = getStageRank(st, measured);
+    }
+
+    // insertion sort, which keeps the order of equally ranked stages
+    for (i = 1; i < n; i++)
+    {
+        int id = order[i];
+        double r = sp->stages[id].rank;
+        for (j = i; j > 0 && sp->stages[order[j-1]].rank > r; j--)
+            order[j] = order[j-1];
+        order[j] = id;
+    }
+}
+
+static void sortStages(SeedPipeline *sp)
+{
+    sortStageGroup(sp, sp->order, sp->cnt48);
+    sortStageGroup(sp, sp->order + sp->cnt48, sp->stagecnt - sp->cnt48);
+}
+
+int addSeedStage(SeedPipeline *sp, int bits, int dim, double cost, double pass,
+        seedstage_t *check, void *data)
+{
+    if (!check || (bits != 48 && bits != 64))
+        return -1;
+
+    if (sp->stagecnt >= sp->stagecap)
+    {
+        int cap = sp->stagecap ? 2 * sp->stagecap : 8;
+        stage_t *stages = (stage_t*) realloc(sp->stages, cap * sizeof(*stages));
+        if (!stages)
+            return -1;
+        sp->stages = stages;
+        int *order = (int*) realloc(sp->order, cap * sizeof(*order));
+        if (!order)
+            return -1;
+        sp->order = order;
+        sp->stagecap = cap;
+    }
+
+    // the per-worker statistics are reallocated on the next run
+    int i;
+    for (i = 0; i < sp->workercnt; i++)
+    {
+        free(sp->workers[i]->stats);
+        free(sp->workers[i]);
+    }
+    free(sp->workers);
+    sp->workers = NULL;
+    sp->workercnt = 0;
+
+    int id = sp->stagecnt++;
+    stage_t *st = sp->stages + id;
+    memset(st, 0, sizeof(*st));
+    st->check = check;
+    st->data = data;
+    st->bits = bits;
+    st->dim = dim;
+    st->cost = cost > 0 ? cost : 1;
+    st->pass = pass < 0 ? 0 : pass > 1 ? 1 : pass;
+
+    if (bits == 48)
+    {   // the 48-bit group precedes the 64-bit stages
+        memmove(sp->order + sp->cnt48 + 1, sp->order + sp->cnt48,
+            (id - sp->cnt48) * sizeof(*sp->order));
+        sp->order[sp->cnt48++] = id;
+    }
+    else
+    {
+        sp->order[id] = id;
+    }
+    sortStages(sp);
+    return id;
+}
+
+static int initWorkers(SeedPipeline *sp, int threads)
+{
+    if (sp->workercnt >= threads)
+        return 0;
+
+    pipeworker_t **workers = (pipeworker_t**)
+        realloc(sp->workers, threads * sizeof(*workers));
+    if (!workers)
+        return 1;
+    sp->workers = workers;
+
+    for (; sp->workercnt < threads; sp->workercnt++)
+    {
+        pipeworker_t *w = (pipeworker_t*) malloc(sizeof(*w));
+        if (!w)
+            return 1;
+        w->stats = (stagestat_t*)
+            calloc(sp->stagecnt ? sp->stagecnt : 1, sizeof(*w->stats));
+        if (!w->stats)
+        {
+            free(w);
+            return 1;
+        }
+        setupGenerator(&w->g, sp->mc, sp->flags);
+        w->gvalid = 0;
+        sp->workers[sp->workercnt] = w;
+    }
+    return 0;
+}
+
+/* Runs the 'n' seeds through the stages [from,to) of the current order and
+ * compacts the survivors to the front. Returns the number of survivors.
+ * The time of an applySeed() counts towards the stage that required it.
+ */
+static size_t runStages(const SeedPipeline *sp, pipeworker_t *w, int worker,
+        int from, int to, uint64_t *seeds, size_t n)
+{
+    int k;
+    for (k = from; k < to && n; k++)
+    {
+        int id = sp->order[k];
+        const stage_t *st = sp->stages + id;
+        double t = getTime();
+        size_t i, m = 0;
+
+        if (st->bits == 48)
+        {
+            for (i = 0; i < n; i++)
+            {
+                if (st->check(seeds[i] & MASK48, &w->g, worker, st->data))
+                    seeds[m++] = seeds[i];
+            }
+        }
+        else
+        {
+            for (i = 0; i < n; i++)
+            {
+                uint64_t seed = seeds[i];
+                if (st->dim != DIM_UNDEF &&
+                    (!w->gvalid || w->gseed != seed || w->gdim != st->dim))
+                {
+                    applySeed(&w->g, st->dim, seed);
+                    w->gseed = seed;
+                    w->gdim = st->dim;
+                    w->gvalid = 1;
+                }
+                if (st->check(seed, &w->g, worker, st->data))
+                    seeds[m++] = seed;
+            }
+        }
+
+        stagestat_t *stat = w->stats + id;
+        stat->tested += n;
+        stat->passed += m;
+        stat->secs += getTime() - t;
+        n = m;
+    }
+    return n;
+}
+
+static int addSeeds(seedlist_t *out, const uint64_t *seeds, size_t n)
+{
+    if (out->len + n > out->cap)
+    {
+        size_t cap = out->cap ? 2 * out->cap : 64;
+        while (cap < out->len + n)
+            cap *= 2;
+        uint64_t *p = (uint64_t*) realloc(out->seeds, cap * sizeof(*p));
+        if (!p)
+            return 1;
+        out->seeds = p;
+        out->cap = cap;
+    }
+    memcpy(out->seeds + out->len, seeds, n * sizeof(*seeds));
+    out->len += n;
+    return 0;
+}
+
+static int runPipeTask(void *data, int task, int worker)
+{
+    const piperun_t *r = (const piperun_t*) data;
+    const SeedPipeline *sp = r->sp;
+    pipeworker_t *w = sp->workers[worker];
+    seedlist_t *out = r->out + task;
+    out->len = 0;
+
+    uint64_t beg = (r->first + task) * PIPE_CHUNK;
+    uint64_t end = beg + PIPE_CHUNK;
+    if (end > r->n)
+        end = r->n;
+    size_t i, j, n = end - beg;
+    memcpy(w->buf, r->seeds + beg, n * sizeof(*w->buf));
+
+    n = runStages(sp, w, worker, 0, sp->cnt48, w->buf, n);
+
+    if (r->inbits != 48 || sp->cnt48 == sp->stagecnt)
+    {
+        n = runStages(sp, w, worker, sp->cnt48, sp->stagecnt, w->buf, n);
+        return addSeeds(out, w->buf, n);
+    }
+
+    // expand the 48-bit survivors to the full seeds for the 64-bit stages
+    for (i = 0; i < n; i++)
+    {
+        uint64_t lower = w->buf[i] & MASK48;
+        uint64_t upper;
+        for (upper = 0; upper < 0x10000; upper += PIPE_CHUNK)
+        {
+            for (j = 0; j < PIPE_CHUNK; j++)
+                w->exp[j] = ((upper + j) << 48) | lower;
+            size_t m = runStages(sp, w, worker, sp->cnt48, sp->stagecnt,
+                w->exp, PIPE_CHUNK);
+            if (addSeeds(out, w->exp, m))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+int runSeedPipeline(SeedPipeline *sp, ThreadPool *pool,
+        const uint64_t *seeds, uint64_t n, int inbits,
+        int (*fn)(void *data, uint64_t seed), void *data)
+{
+    int threads = pool ? getThreadCount(pool) : 1;
+    int window = PIPE_WINDOW * threads;
+    int i, t, err = 0;
+    size_t k;
+
+    if (initWorkers(sp, threads))
+        return -1;
+
+    piperun_t r;
+    r.sp = sp;
+    r.seeds = seeds;
+    r.n = n;
+    r.inbits = inbits;
+    r.out = (seedlist_t*) calloc(window, sizeof(seedlist_t));
+    if (!r.out)
+        return -1;
+
+    uint64_t chunkcnt = (n + PIPE_CHUNK - 1) / PIPE_CHUNK;
+    for (r.first = 0; r.first < chunkcnt && !err; r.first += window)
+    {
+        int tasks = window;
+        if (r.first + tasks > chunkcnt)
+            tasks = (int)(chunkcnt - r.first);
+
+        if (pool)
+        {
+            if (runThreadPool(pool, tasks, runPipeTask, &r))
+                err = -1;
+        }
+        else
+        {
+            for (t = 0; t < tasks && !err; t++)
+                if (runPipeTask(&r, t, 0))
+                    err = -1;
+        }
+
+        // gather the statistics and update the stage order
+        for (i = 0; i < sp->stagecnt; i++)
+        {
+            stage_t *st = sp->stages + i;
+            for (t = 0; t < threads; t++)
+            {
+                stagestat_t *stat = sp->workers[t]->stats + i;
+                st->tested += stat->tested;
+                st->passed += stat->passed;
+                st->secs += stat->secs;
+                memset(stat, 0, sizeof(*stat));
+            }
+        }
+        sortStages(sp);
+
+        for (t = 0; t < tasks && !err; t++)
+        {
+            for (k = 0; k < r.out[t].len && !err; k++)
+                err = fn(data, r.out[t].seeds[k]);
+        }
+    }
+
+    for (t = 0; t < window; t++)
+        free(r.out[t].seeds);
+    free(r.out);
+    return err;
+}
+
+int getSeedStageStats(const SeedPipeline *sp, int stage,
+        uint64_t *tested, uint64_t *passed, double *secs)
+{
+    if (stage < 0 || stage >= sp->stagecnt)
+        return 1;
+    const stage_t *st = sp->stages + stage;
+    if (tested) *tested = st->tested;
+    if (passed) *passed = st->passed;
+    if (secs) *secs = st->secs;
+    return 0;
+}
+
+int getSeedStageOrder(const SeedPipeline *sp, int *order)
+{
+    memcpy(order, sp->order, sp->stagecnt * sizeof(*order));
+    return sp->stagecnt;
+}
+
@@ -0,0 +1,98 @@
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include "generator.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* A seed filter pipeline chains a number of seed tests (stages), such as
+ * structure positions, quad-bases, isViableStructurePos(), checkForBiomes() or
+ * monteCarloBiomes(), and runs batches of seeds through them on a thread pool.
+ *
+ * Each stage tests either the lower 48 bits of the seeds (bits = 48), which
+ * suffice for the structure positions, or the full 64-bit seeds (bits = 64),
+ * for which the worker's generator has been applied to the seed in the
+ * dimension of the stage. All 48-bit stages run before the 64-bit stages, and
+ * when the input consists of 48-bit seeds, the survivors are expanded to the
+ * 2^16 variants of their upper bits only once they reach the 64-bit stages.
+ *
+ * Within each of the two groups, the stages are ordered such that cheap and
+ * selective tests come first, by their cost per seed over the fraction of seeds
+ * that they reject. The order starts with the estimates given to
+ * addSeedStage() and is adjusted between batches from the observed pass rates
+ * and run times. Since a seed has to pass every stage, the order only affects
+ * the speed, and the output is the same for any order.
+ */
+typedef struct SeedPipeline SeedPipeline;
+
+/* The test function of a stage, which should return nonzero for seeds that
+ * pass. For 64-bit stages 'g' has been applied to the seed in the dimension of
+ * the stage, while for 48-bit stages (and 64-bit stages in DIM_UNDEF) it is
+ * only set up for the version of the pipeline. Stages run in parallel and
+ * should keep any scratch data per worker, which is given by 'worker' in the
+ * range [0,threads) of the pool.
+ */
+typedef int (seedstage_t)(uint64_t seed, Generator *g, int worker, void *data);
+
+/* Creates an empty pipeline for the given MC version and generator flags
+ * (see setupGenerator()). Returns NULL upon failure.
+ */
+SeedPipeline *createSeedPipeline(int mc, uint32_t flags);
+
+/* Frees the pipeline. (Nullable) */
+void freeSeedPipeline(SeedPipeline *sp);
+
+/* Adds a stage to the pipeline.
+ *
+ * @bits        : 48 to test the lower 48 bits or 64 to test full seeds
+ * @dim         : dimension for applySeed(), or DIM_UNDEF for 64-bit stages
+ *                that do not use the generator (ignored for 48-bit stages)
+ * @cost        : estimated relative cost per seed (e.g. 1 for a structure
+ *                position and several thousand for a biome check)
+ * @pass        : estimated fraction of seeds that pass
+ * @check       : the test function
+ * @data        : custom data argument passed to 'check'
+ *
+ * Returns the index of the stage, or -1 upon failure.
+ */
+int addSeedStage(SeedPipeline *sp, int bits, int dim, double cost, double pass,
+        seedstage_t *check, void *data);
+
+/* Runs 'n' seeds through the pipeline using the workers of 'pool' (nullable
+ * for the calling thread). If 'inbits' is 48, the input seeds are 48-bit and
+ * the survivors are expanded before the 64-bit stages, otherwise the input
+ * seeds are full 64-bit seeds. The seeds that pass all stages are passed to
+ * 'fn' in ascending input order (with the expanded seeds in ascending order of
+ * their upper bits), until 'fn' returns nonzero. The statistics of the stages
+ * carry over between runs.
+ *
+ * Returns zero upon success, the nonzero value returned by 'fn', or -1 if the
+ * run failed.
+ */
+int runSeedPipeline(SeedPipeline *sp, ThreadPool *pool,
+        const uint64_t *seeds, uint64_t n, int inbits,
+        int (*fn)(void *data, uint64_t seed), void *data);
+
+/* Gets the statistics of a stage: the number of seeds tested and passed and
+ * the total run time in seconds. The arguments are nullable.
+ * Returns zero upon success.
+ */
+int getSeedStageStats(const SeedPipeline *sp, int stage,
+        uint64_t *tested, uint64_t *passed, double *secs);
+
+/* Writes the indices of the stages in their current order of execution to
+ * 'order' and returns the number of stages.
+ */
+int getSeedStageOrder(const SeedPipeline *sp, int *order);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PIPELINE_H_ */
+
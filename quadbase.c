@@ -1,8 +1,14 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L // for fileno() and ftruncate()
+#endif
+
 #include "quadbase.h"
 #include "util.h"
 
 #include <string.h>
+#include <errno.h>
 #include <limits.h>
+#include <time.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -10,13 +16,15 @@
 
 #if defined(_WIN32)
 
-#include <windows.h>
-typedef HANDLE thread_id_t;
 #include <direct.h>
+#include <io.h>
 #define IS_DIR_SEP(C)   ((C) == '/' || (C) == '\\')
 #define stat            _stat
 #define mkdir(P,X)      _mkdir(P)
 #define S_IFDIR         _S_IFDIR
+#define fileno          _fileno
+#define ftruncate       _chsize_s
+#define fsync           _commit
 
 #ifndef _S_ISTYPE
 #define _S_ISTYPE(mode, mask)  (((mode) & _S_IFMT) == (mask))
@@ -28,9 +36,7 @@ typedef HANDLE thread_id_t;
 
 #else
 
-#define USE_PTHREAD
-#include <pthread.h>
-typedef pthread_t       thread_id_t;
+#include <unistd.h>
 #define IS_DIR_SEP(C)   ((C) == '/')
 
 #endif
@@ -62,6 +68,199 @@ int getQuadHutCst(uint64_t low20)
 // TODO: accurate seed testers for two or three structures in range
 
 
+/* The lane checks test the two structures of the opposing diagonal regions
+ * (0,0) and (1,1), which rejects almost all seeds, for all lanes at once with
+ * 64-bit vector arithmetic. The remaining lanes are confirmed by the scalar
+ * checks, so the results are identical.
+ * The modulo of the 31-bit PRNG outputs uses a double precision reciprocal of
+ * the chunk range that is rounded up, so that the truncated quotient is exact,
+ * which avoids two of the (slow) 64-bit vector multiplications per nextInt().
+ */
+STRUCT(QuadPrefilter)
+{
+    uint64_t salt;
+    int C;              // chunk range
+    int twice;          // positions are the sum of two nextInt (large)
+    int rm0;            // the first structure needs x0,z0 > rm0
+    int rm1;            // the second structure needs x1,z1 < x0,z0 - rm1
+    double inv;         // (int)(x * inv) == x / C, for x < 2^31
+};
+
+static void initQuadPrefilter(QuadPrefilter *qp, const StructureConfig *sconf,
+        int twice, int rm0, int rm1)
+{
+    qp->salt = sconf->salt;
+    qp->C = sconf->chunkRange;
+    qp->twice = twice;
+    qp->rm0 = rm0;
+    qp->rm1 = rm1;
+    qp->inv = 1.0 / qp->C;
+    if (qp->inv * qp->C < 1.0)
+        qp->inv = nextafter(qp->inv, 2.0);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QUAD_SIMD_X86 1
+#endif
+
+#if QUAD_SIMD_X86
+
+// The helpers are always inlined, so their vector ABI does not matter.
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+typedef uint64_t    quadu64_t   __attribute__((vector_size(8 * LANE_CNT)));
+typedef int64_t     quad64_t    __attribute__((vector_size(8 * LANE_CNT)));
+typedef int32_t     quad32_t    __attribute__((vector_size(4 * LANE_CNT)));
+typedef double      quadf64_t   __attribute__((vector_size(8 * LANE_CNT)));
+
+static inline ATTR(always_inline)
+quad32_t quadNextInt(quadu64_t *s, const QuadPrefilter *qp)
+{
+    *s = (*s * 0x5deece66dULL + 0xb) & ((1ULL << 48) - 1);
+    quad32_t x = __builtin_convertvector((quad64_t)(*s >> 17), quad32_t);
+    quadf64_t d = __builtin_convertvector(x, quadf64_t);
+    quad32_t q = __builtin_convertvector(d * qp->inv, quad32_t);
+    return x - q * qp->C;
+}
+
+static inline ATTR(always_inline)
+quad32_t quadNextPos(quadu64_t *s, const QuadPrefilter *qp)
+{
+    quad32_t p = quadNextInt(s, qp);
+    if (qp->twice)
+        p += quadNextInt(s, qp);
+    return p;
+}
+
+static ATTR(target("avx512f,avx512dq,avx512vl"))
+uint32_t quadPrefilterAVX512(const QuadPrefilter *qp, const uint64_t *seeds)
+{
+    const uint64_t K = 0x5deece66dULL;
+    quadu64_t s00, s11;
+    memcpy(&s00, seeds, sizeof(s00));
+    s00 += qp->salt;
+    s11 = s00 + (341873128712ULL + 132897987541ULL);
+    s00 ^= K;
+    s11 ^= K;
+
+    quad32_t x0 = quadNextPos(&s00, qp);
+    quad32_t z0 = quadNextPos(&s00, qp);
+    quad32_t x1 = quadNextPos(&s11, qp);
+    quad32_t z1 = quadNextPos(&s11, qp);
+    quad32_t m = (x0 > qp->rm0) & (z0 > qp->rm0) &
+        (x1 + qp->rm1 < x0) & (z1 + qp->rm1 < z0);
+
+    uint32_t bits = 0;
+    int i;
+    for (i = 0; i < LANE_CNT; i++)
+        bits |= (uint32_t)(m[i] & 1) << i;
+    return bits;
+}
+
+#endif // QUAD_SIMD_X86
+
+/* Returns the lanes that pass the prefilter. Without the 64-bit vector
+ * multiplication of AVX-512, the scalar checks reject seeds faster on their
+ * own, so all lanes are passed on to them.
+ */
+static uint32_t runQuadPrefilter(const QuadPrefilter *qp, const uint64_t *seeds)
+{
+#if QUAD_SIMD_X86
+    if (__builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl"))
+        return quadPrefilterAVX512(qp, seeds);
+#endif
+    (void) qp;
+    (void) seeds;
+    return (1U << LANE_CNT) - 1;
+}
+
+uint32_t isQuadBaseFeature24Lanes(const StructureConfig sconf,
+        const uint64_t *seeds, int ax, int ay, int az)
+{
+    QuadPrefilter qp;
+    StructureConfig sc = sconf;
+    sc.chunkRange = 24;
+    initQuadPrefilter(&qp, &sc, 0, 19, 19);
+    uint32_t bits = runQuadPrefilter(&qp, seeds);
+    uint32_t hits = 0;
+    int i;
+    for (i = 0; bits; i++, bits >>= 1)
+        if ((bits & 1) && isQuadBaseFeature24(sconf, seeds[i], ax, ay, az))
+            hits |= 1U << i;
+    return hits;
+}
+
+uint32_t isQuadBaseFeatureLanes(const StructureConfig sconf,
+        const uint64_t *seeds, int ax, int ay, int az, int radius)
+{
+    const int R = sconf.regionSize;
+    const int C = sconf.chunkRange;
+    int cd = radius/8;
+    int rm = R - (int)sqrtf(cd*cd - (R-C+1)*(R-C+1));
+
+    QuadPrefilter qp;
+    initQuadPrefilter(&qp, &sconf, 0, rm, rm);
+    uint32_t bits = runQuadPrefilter(&qp, seeds);
+    uint32_t hits = 0;
+    int i;
+    for (i = 0; bits; i++, bits >>= 1)
+        if ((bits & 1) && isQuadBaseFeature(sconf, seeds[i], ax, ay, az, radius))
+            hits |= 1U << i;
+    return hits;
+}
+
+uint32_t isQuadBaseLargeLanes(const StructureConfig sconf,
+        const uint64_t *seeds, int ax, int ay, int az, int radius)
+{
+    const int R = sconf.regionSize;
+    int rm = (int)(2 * R + ((ax<az?ax:az) - 2*radius + 7) / 8);
+
+    QuadPrefilter qp;
+    initQuadPrefilter(&qp, &sconf, 1, rm, rm-1);
+    uint32_t bits = runQuadPrefilter(&qp, seeds);
+    uint32_t hits = 0;
+    int i;
+    for (i = 0; bits; i++, bits >>= 1)
+        if ((bits & 1) && isQuadBaseLarge(sconf, seeds[i], ax, ay, az, radius))
+            hits |= 1U << i;
+    return hits;
+}
+
+uint32_t isQuadBaseLanes(const StructureConfig sconf, const uint64_t *seeds,
+        int radius)
+{
+    switch(sconf.structType)
+    {
+    case Swamp_Hut:
+        if (radius == 128)
+            return isQuadBaseFeature24Lanes(sconf, seeds, 7+1, 7+1, 9+1);
+        else
+            return isQuadBaseFeatureLanes(sconf, seeds, 7+1, 7+1, 9+1, radius);
+    case Desert_Pyramid:
+    case Jungle_Pyramid:
+    case Igloo:
+    case Village:
+        if (radius == 128)
+            return isQuadBaseFeature24Lanes(sconf, seeds, 0, 0, 0);
+        else
+            return isQuadBaseFeatureLanes(sconf, seeds, 0, 0, 0, radius);
+    case Outpost:
+        return isQuadBaseFeatureLanes(sconf, seeds, 72, 54, 72, radius);
+    case Monument:
+        return isQuadBaseLargeLanes(sconf, seeds, 58, 23, 58, radius);
+    case Ocean_Ruin:
+    case Shipwreck:
+    case Ruined_Portal:
+        return isQuadBaseFeatureLanes(sconf, seeds, 0, 0, 0, radius);
+    default:
+        fprintf(stderr, "isQuadBaseLanes: not implemented for structure type %d\n",
+                sconf.structType);
+        exit(-1);
+    }
+    return 0;
+}
+
+
 static int blocksInRange(Pos *p, int n, int x, int z, int ax, int az, double rsq)
 {
     int i, cnt;
@@ -225,34 +424,61 @@ Pos getOptimalAfk(Pos p[4], int ax, int ay, int az, int *spcnt)
 
 #define MAX_PATHLEN 4096
 
-STRUCT(linked_seeds_t)
+// The search space is divided into blocks of at least 2^28 seeds, which are
+// handed out to the workers in ascending order.
+#define SEARCH48_BLOCK_BITS 28
+// Minimum interval in seconds between syncs of the progress files to disk.
+#define SEARCH48_SYNC_SECS  5
+
+STRUCT(threadinfo_t)
 {
-    uint64_t seeds[100];
-    size_t len;
-    linked_seeds_t *next;
+    // output
+    char path[MAX_PATHLEN];
+    FILE *fp;
+    time_t synced;
+    uint64_t *seeds; // found seeds (only of the current block with a file)
+    uint64_t len, cap;
 };
 
-STRUCT(threadinfo_t)
+STRUCT(search48_t)
 {
     // seed range
-    uint64_t start, end;
+    int blockBits;
     const uint64_t *lowBits;
     int lowBitN;
-    char skipStart;
+    int lowCnt;
 
-    // testing function
+    // testing function, or its lane variant
     int (*check)(uint64_t, void*);
+    uint32_t (*checkLanes)(const uint64_t*, void*);
     void *data;
 
     // abort check
     volatile char *stop;
 
-    // output
-    char path[MAX_PATHLEN];
-    FILE *fp;
-    linked_seeds_t ls;
+    SeedFileHeader hdr;
+    threadinfo_t *info;
+    uint8_t *done; // bitset of the completed blocks
 };
 
+STRUCT(record_t)
+{
+    uint32_t block;
+    int part;
+    long offset;
+};
+
+
+/* Flushes a file and waits for its data to reach the disk, so that the
+ * records written so far survive a crash or power loss. (Files that cannot be
+ * synchronized, such as pipes, are only flushed.)
+ */
+static int syncFile(FILE *fp)
+{
+    if (fflush(fp))
+        return 1;
+    return fsync(fileno(fp)) != 0 && errno != EINVAL;
+}
 
 static int mkdirp(char *path)
 {
@@ -285,119 +511,346 @@ static int mkdirp(char *path)
     return err;
 }
 
+static int addSeed(threadinfo_t *info, uint64_t seed)
+{
+    if (info->len >= info->cap)
+    {
+        uint64_t cap = info->cap ? 2 * info->cap : 128;
+        uint64_t *seeds = (uint64_t*) realloc(info->seeds, cap * sizeof(*seeds));
+        if (seeds == NULL)
+            return 1;
+        info->seeds = seeds;
+        info->cap = cap;
+    }
+    info->seeds[info->len++] = seed;
+    return 0;
+}
 
-#ifdef USE_PTHREAD
-static void *searchAll48Thread(void *data)
-#else
-static DWORD WINAPI searchAll48Thread(LPVOID data)
-#endif
+static int cmp_seed(const void *a, const void *b)
 {
-// TODO TEST:
-// lower bits with various ranges
+    uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
 
-    threadinfo_t *info = (threadinfo_t*)data;
+static int cmp_record(const void *a, const void *b)
+{
+    uint32_t x = ((const record_t*) a)->block, y = ((const record_t*) b)->block;
+    return (x > y) - (x < y);
+}
 
-    uint64_t seed = info->start;
-    uint64_t end = info->end;
-    linked_seeds_t *lp = &info->ls;
-    lp->len = 0;
-    lp->next = NULL;
+/* Tests the 'cnt' collected seeds of 'lane' with the lane check, where the
+ * unused lanes are padded with the last seed.
+ */
+static int flushLanes(const search48_t *s, threadinfo_t *info,
+        uint64_t *lane, int *cnt)
+{
+    int i, n = *cnt;
+    if (n <= 0)
+        return 0;
+    for (i = n; i < LANE_CNT; i++)
+        lane[i] = lane[n-1];
+    *cnt = 0;
 
-    if (info->lowBits)
+    uint32_t bits = s->checkLanes(lane, s->data) & ((1U << n) - 1);
+    for (i = 0; bits; i++, bits >>= 1)
     {
-        uint64_t hstep = 1ULL << info->lowBitN;
-        uint64_t hmask = ~(hstep - 1);
-        uint64_t mid;
-        int idx, cnt;
+        if ((bits & 1) && addSeed(info, lane[i]))
+            return 1;
+    }
+    return 0;
+}
 
-        for (cnt = 0; info->lowBits[cnt]; cnt++);
+static inline ATTR(always_inline)
+int testSeed(const search48_t *s, threadinfo_t *info,
+        uint64_t *lane, int *cnt, uint64_t seed)
+{
+    if (s->checkLanes)
+    {
+        lane[(*cnt)++] = seed;
+        return *cnt < LANE_CNT ? 0 : flushLanes(s, info, lane, cnt);
+    }
+    if unlikely(s->check(seed, s->data))
+        return addSeed(info, seed);
+    return 0;
+}
 
-        mid = info->start & hmask;
-        for (idx = 0; (seed = mid | info->lowBits[idx]) < info->start; idx++);
+/* Checks one block of the search space. The results of a block are only
+ * written out as a record, once the whole block has been checked, so that an
+ * interrupted search can resume exactly. The records are buffered and flushed
+ * periodically.
+ */
+static int searchAll48Block(void *data, int block, int worker)
+{
+    const search48_t *s = (const search48_t*) data;
+    threadinfo_t *info = s->info + worker;
 
-        while (seed <= end)
+    if (s->done[block >> 3] & (1 << (block & 7)))
+        return 0;
+    if (s->stop && *s->stop)
+        return 1;
+
+    uint64_t seed = (uint64_t)block << s->blockBits;
+    uint64_t end = seed + (1ULL << s->blockBits);
+    uint64_t len0 = info->len;
+    uint64_t lane[LANE_CNT];
+    int lanecnt = 0;
+    int err = 0;
+
+    if (s->lowBits)
+    {
+        uint64_t hstep = 1ULL << s->lowBitN;
+        uint64_t mid;
+        int idx;
+
+        for (mid = seed; mid < end && !err; mid += hstep)
         {
-            if unlikely(info->check(seed, info->data))
+            for (idx = 0; idx < s->lowCnt && !err; idx++)
             {
-                if (seed == info->start && info->skipStart) {} // skip
-                else if (info->fp)
-                {
-                    fprintf(info->fp, "%" PRId64"\n", (int64_t)seed);
-                    fflush(info->fp);
-                }
-                else
-                {
-                    lp->seeds[lp->len] = seed;
-                    lp->len++;
-                    if (lp->len >= sizeof(lp->seeds)/sizeof(uint64_t))
-                    {
-                        linked_seeds_t *n =
-                            (linked_seeds_t*) malloc(sizeof(linked_seeds_t));
-                        if (n == NULL)
-                            exit(1);
-                        lp->next = n;
-                        lp = n;
-                        lp->len = 0;
-                        lp->next = NULL;
-                    }
-                }
+                seed = mid | s->lowBits[idx];
+                err = testSeed(s, info, lane, &lanecnt, seed);
             }
+            if (s->stop && *s->stop)
+                err = 1;
+        }
+    }
+    else
+    {
+        for (; seed < end && !err; seed++)
+        {
+            err = testSeed(s, info, lane, &lanecnt, seed);
+            if ((seed & 0xfff) == 0xfff && s->stop && *s->stop)
+                err = 1;
+        }
+    }
+
+    if (!err)
+        err = flushLanes(s, info, lane, &lanecnt);
+    if (err)
+    {   // discard the partial block
+        info->len = len0;
+        return err;
+    }
+
+    if (info->fp)
+    {
+        qsort(info->seeds, info->len, sizeof(*info->seeds), cmp_seed);
+        if (writeSeedRecord(info->fp, &s->hdr, block, info->seeds, info->len))
+            return 1;
+        info->len = 0;
+        time_t now = time(NULL);
+        if (now - info->synced >= SEARCH48_SYNC_SECS)
+        {
+            if (syncFile(info->fp))
+                return 1;
+            info->synced = now;
+        }
+    }
+    return 0;
+}
+
+/* Opens the progress file of a worker for appending. The completed blocks of
+ * an existing file are marked as done, and an incomplete record at its end is
+ * cut off. A file of a different search sets 'foreign' (nullable).
+ */
+static FILE *openProgress(const char *path, const SeedFileHeader *hdr,
+        uint8_t *done, int blockcnt, int *foreign)
+{
+    SeedFileHeader fhdr;
+    FILE *fp = fopen(path, "r+b");
+    uint64_t *seeds = NULL, n, cap = 0;
+    uint32_t block;
+    long keep;
+    int ret, cnt = 0;
+
+    if (fp == NULL)
+    {   // new search
+        fp = fopen(path, "w+b");
+        if (fp == NULL || writeSeedFileHeader(fp, hdr))
+            goto L_err;
+        return fp;
+    }
+
+    if (readSeedFileHeader(fp, &fhdr) ||
+        fhdr.blockBits != hdr->blockBits || fhdr.lowBitN != hdr->lowBitN ||
+        fhdr.lowCnt != hdr->lowCnt || fhdr.lowHash != hdr->lowHash ||
+        fhdr.start != hdr->start || fhdr.end != hdr->end)
+    {
+        printf("Progress file %s does not belong to this search\n", path);
+        if (foreign)
+            *foreign = 1;
+        goto L_err;
+    }
+
+    while (1)
+    {
+        keep = ftell(fp);
+        n = 0;
+        ret = readSeedRecord(fp, hdr, &block, &seeds, &n, &cap);
+        if (ret <= 0)
+            break;
+        if (block < (uint32_t) blockcnt)
+        {
+            done[block >> 3] |= 1 << (block & 7);
+            cnt++;
+        }
+    }
+    free(seeds);
 
-            idx++;
-            if (idx >= cnt)
+    if (ret < 0)
+    {   // drop the incomplete record
+        fflush(fp);
+        if (keep < 0 || ftruncate(fileno(fp), keep))
+            goto L_err;
+    }
+    if (fseek(fp, 0, SEEK_END))
+        goto L_err;
+
+    if (cnt)
+        printf("Continuing search with %d blocks from %s\n", cnt, path);
+    return fp;
+
+L_err:
+    if (fp)
+        fclose(fp);
+    return NULL;
+}
+
+/* Gets the number of progress files for the output path, which is at least
+ * the number of workers, but also covers the files of an earlier run with more
+ * threads, since any worker may have completed any block.
+ */
+static int getProgressCount(const char *path, int threads)
+{
+    char ppath[MAX_PATHLEN];
+    struct stat st;
+    int n = threads;
+    while (1)
+    {
+        snprintf(ppath, sizeof(ppath), "%s.part%d", path, n);
+        if (stat(ppath, &st) != 0)
+            break;
+        n++;
+    }
+    return n;
+}
+
+/* Writes the results of all progress files to the output path in ascending
+ * order, and optionally also to a seed buffer.
+ */
+static int mergeProgress(const search48_t *s, int parts, const char *path,
+        uint64_t **seedbuf, uint64_t *buflen)
+{
+    record_t *rec = NULL;
+    size_t reccnt = 0, reccap = 0;
+    uint64_t *seeds = NULL, n = 0, cap = 0;
+    uint64_t *all = NULL, len = 0, allcap = 0;
+    SeedFileHeader fhdr;
+    uint32_t block;
+    FILE *fp = NULL;
+    int t, ret, err = 1;
+    size_t i;
+
+    // index the records of each part
+    for (t = 0; t < parts; t++)
+    {
+        FILE *pf = s->info[t].fp;
+        if (pf == NULL)
+            continue;
+        if (fflush(pf) || fseek(pf, 0, SEEK_SET) || readSeedFileHeader(pf, &fhdr))
+            goto L_end;
+        while (1)
+        {
+            long offset = ftell(pf);
+            n = 0;
+            ret = readSeedRecord(pf, &s->hdr, &block, &seeds, &n, &cap);
+            if (ret < 0)
+                goto L_end;
+            if (ret == 0)
+                break;
+            if (n == 0)
+                continue;
+            if (reccnt >= reccap)
             {
-                idx = 0;
-                mid += hstep;
-                if (info->stop && *info->stop)
-                    break;
+                reccap = reccap ? 2 * reccap : 1024;
+                record_t *r = (record_t*) realloc(rec, reccap * sizeof(*r));
+                if (r == NULL)
+                    goto L_end;
+                rec = r;
             }
-
-            seed = mid | info->lowBits[idx];
+            rec[reccnt].block = block;
+            rec[reccnt].part = t;
+            rec[reccnt].offset = offset;
+            reccnt++;
         }
     }
-    else
+    qsort(rec, reccnt, sizeof(*rec), cmp_record);
+
+    // binary output is selected by the file extension
+    size_t pathlen = strlen(path);
+    int binary = pathlen >= 4 && strcmp(path + pathlen - 4, ".bin") == 0;
+    fp = fopen(path, binary ? "wb" : "w");
+    if (fp == NULL)
+        goto L_end;
+    if (binary && writeSeedFileHeader(fp, &s->hdr))
+        goto L_end;
+
+    for (i = 0; i < reccnt; i++)
     {
-        while (seed <= end)
+        FILE *pf = s->info[rec[i].part].fp;
+        n = 0;
+        if (fseek(pf, rec[i].offset, SEEK_SET) ||
+            readSeedRecord(pf, &s->hdr, &block, &seeds, &n, &cap) != 1)
+            goto L_end;
+        if (binary)
         {
-            if unlikely(info->check(seed, info->data))
+            if (writeSeedRecord(fp, &s->hdr, block, seeds, n))
+                goto L_end;
+        }
+        else
+        {
+            uint64_t k;
+            for (k = 0; k < n; k++)
+                fprintf(fp, "%" PRId64"\n", (int64_t)seeds[k]);
+        }
+        if (seedbuf)
+        {
+            if (len + n > allcap)
             {
-                if (seed == info->start && info->skipStart) {} // skip
-                else if (info->fp)
-                {
-                    fprintf(info->fp, "%" PRId64"\n", (int64_t)seed);
-                    fflush(info->fp);
-                }
-                else
-                {
-                    lp->seeds[lp->len] = seed;
-                    lp->len++;
-                    if (lp->len >= sizeof(lp->seeds)/sizeof(uint64_t))
-                    {
-                        linked_seeds_t *n =
-                            (linked_seeds_t*) malloc(sizeof(linked_seeds_t));
-                        if (n == NULL)
-                            exit(1);
-                        lp->next = n;
-                        lp = n;
-                        lp->len = 0;
-                        lp->next = NULL;
-                    }
-                }
+                allcap = allcap ? allcap : 1024;
+                while (allcap < len + n)
+                    allcap *= 2;
+                uint64_t *a = (uint64_t*) realloc(all, allcap * sizeof(*a));
+                if (a == NULL)
+                    goto L_end;
+                all = a;
             }
-            seed++;
-            if ((seed & 0xfff) == 0 && info->stop && *info->stop)
-                break;
+            memcpy(all + len, seeds, n * sizeof(*seeds));
+            len += n;
         }
     }
+    // the output must be on disk before the progress files are removed
+    err = syncFile(fp);
+    err |= fclose(fp) != 0;
+    fp = NULL;
 
-#ifdef USE_PTHREAD
-    pthread_exit(NULL);
-#endif
-    return 0;
+    if (!err && seedbuf)
+    {
+        *seedbuf = all;
+        *buflen = len;
+        all = NULL;
+    }
+
+L_end:
+    if (fp)
+        fclose(fp);
+    free(rec);
+    free(seeds);
+    free(all);
+    return err;
 }
 
 
-int searchAll48(
+static int runSearchAll48(
         uint64_t **         seedbuf,
         uint64_t *          buflen,
         const char *        path,
@@ -405,22 +858,47 @@ int searchAll48(
         const uint64_t *    lowBits,
         int                 lowBitN,
         int (*check)(uint64_t s48, void *data),
+        uint32_t (*checkLanes)(const uint64_t *seeds, void *data),
         void *              data,
         volatile char *     stop
         )
 {
-    threadinfo_t *info = (threadinfo_t*) malloc(threads* sizeof(*info));
-    thread_id_t *tids = (thread_id_t*) malloc(threads* sizeof(*tids));
+    if (threads <= 0)
+        threads = getProcessorCount();
+
+    search48_t s;
+    s.blockBits = SEARCH48_BLOCK_BITS;
+    if (lowBits && lowBitN > s.blockBits)
+        s.blockBits = lowBitN;
+    s.lowBits = lowBits;
+    s.lowBitN = lowBitN;
+    s.lowCnt = 0;
+    if (lowBits)
+        while (lowBits[s.lowCnt]) s.lowCnt++;
+    s.check = check;
+    s.checkLanes = checkLanes;
+    s.data = data;
+    s.stop = stop;
+    initSeedFileHeader(&s.hdr, s.blockBits, lowBits, lowBitN, 0, MASK48+1);
+
+    int blockcnt = 1 << (48 - s.blockBits);
+    int parts = path ? getProgressCount(path, threads) : threads;
+    s.info = (threadinfo_t*) calloc(parts, sizeof(threadinfo_t));
+    s.done = (uint8_t*) calloc((blockcnt + 7) / 8, 1);
+    ThreadPool *tp = NULL;
     int i, t;
     int err = 0;
 
+    if (!s.info || !s.done)
+        goto L_err;
+
     if (path)
     {
         size_t pathlen = strlen(path);
         char dpath[MAX_PATHLEN];
 
         // split path into directory and file and create missing directories
-        if (pathlen + 8 >= sizeof(dpath))
+        if (pathlen + 16 >= sizeof(dpath))
             goto L_err;
         strcpy(dpath, path);
 
@@ -441,185 +919,160 @@ int searchAll48(
         goto L_err;
     }
 
-    // prepare the thread info and load progress if present
-    for (t = 0; t < threads; t++)
+    // load the progress of each worker if present, and of the extra parts of
+    // an earlier run with more threads, which are only merged into the output
+    for (t = 0; t < parts && path; t++)
     {
-        info[t].start = (t * (MASK48+1) / threads);
-        info[t].end = ((t+1) * (MASK48+1) / threads - 1);
-        info[t].lowBits = lowBits;
-        info[t].lowBitN = lowBitN;
-        info[t].skipStart = 0;
-        info[t].check = check;
-        info[t].data = data;
-        info[t].stop = stop;
-
-        if (path)
+        threadinfo_t *info = s.info + t;
+        int foreign = 0;
+        snprintf(info->path, sizeof(info->path), "%s.part%d", path, t);
+        info->fp = openProgress(info->path, &s.hdr, s.done, blockcnt, &foreign);
+        if (info->fp == NULL)
         {
-            // progress file of this thread
-            snprintf(info[t].path, sizeof(info[t].path), "%s.part%d", path, t);
-            FILE *fp = fopen(info[t].path, "a+");
-            if (fp == NULL)
+            if (t < threads || !foreign)
                 goto L_err;
-
-            int c, nnl = 0;
-            char buf[32];
-
-            // find the last newline
-            for (i = 1; i < 32; i++)
-            {
-                if (fseek(fp, -i, SEEK_END)) break;
-                c = fgetc(fp);
-                if (c <= 0 || (nnl && c == '\n')) break;
-                nnl |= (c != '\n');
-            }
-
-            if (i < 32 && !fseek(fp, 1-i, SEEK_END) && fread(buf, i-1, 1, fp) > 0)
-            {
-                // read the last entry, and replace the start seed accordingly
-                int64_t lentry;
-                if (sscanf(buf, "%" PRId64, &lentry) == 1)
-                {
-                    info[t].start = lentry;
-                    info[t].skipStart = 1;
-                    printf("Continuing thread %d at seed %" PRId64 "\n",
-                        t, lentry);
-                }
-            }
-
-            fseek(fp, 0, SEEK_END);
-            info[t].fp = fp;
-        }
-        else
-        {
-            info[t].path[0] = 0;
-            info[t].fp = NULL;
+            info->path[0] = 0; // extra part of another search: leave it be
         }
+        info->synced = time(NULL);
     }
 
+    // run the workers
+    tp = createThreadPool(threads);
+    if (tp == NULL)
+        goto L_err;
+    err = runThreadPool(tp, blockcnt, searchAll48Block, &s);
 
-    // run the threads
-#ifdef USE_PTHREAD
-
-    for (t = 0; t < threads; t++)
-    {
-        pthread_create(&tids[t], NULL, searchAll48Thread, (void*)&info[t]);
-    }
-
-    for (t = 0; t < threads; t++)
-    {
-        pthread_join(tids[t], NULL);
-    }
-
-#else
-
-    for (t = 0; t < threads; t++)
-    {
-        tids[t] = CreateThread(NULL, 0, searchAll48Thread,
-            (LPVOID)&info[t], 0, NULL);
-    }
-
-    WaitForMultipleObjects(threads, tids, TRUE, INFINITE);
-
-#endif
-
-    if (stop && *stop)
+    if (err || (stop && *stop))
         goto L_err;
 
     if (path)
     {
-        // merge partial files
-        FILE *fp = fopen(path, "w");
-        if (fp == NULL)
+        // replace the partial files by the output file
+        if (mergeProgress(&s, parts, path,
+                seedbuf && buflen ? seedbuf : NULL, buflen))
             goto L_err;
-
-        for (t = 0; t < threads; t++)
+        for (t = 0; t < parts; t++)
         {
-            rewind(info[t].fp);
-
-            char buffer[4097];
-            size_t n;
-            while ((n = fread(buffer, sizeof(char), 4096, info[t].fp)))
-            {
-                if (!fwrite(buffer, sizeof(char), n, fp))
-                {
-                    fclose(fp);
-                    goto L_err;
-                }
-            }
-
-            fclose(info[t].fp);
-            remove(info[t].path);
-        }
-
-        fclose(fp);
-
-        if (seedbuf && buflen)
-        {
-            *seedbuf = loadSavedSeeds(path, buflen);
+            if (s.info[t].fp == NULL)
+                continue;
+            fclose(s.info[t].fp);
+            s.info[t].fp = NULL;
+            remove(s.info[t].path);
         }
     }
     else
     {
-        // merge linked seed buffers
-        *buflen = 0;
-
+        // gather the results in ascending order
+        uint64_t len = 0;
         for (t = 0; t < threads; t++)
-        {
-            linked_seeds_t *lp = &info[t].ls;
-            do
-            {
-                *buflen += lp->len;
-                lp = lp->next;
-            }
-            while (lp);
-        }
-
-        *seedbuf = (uint64_t*) malloc((*buflen) * sizeof(uint64_t));
-        if (*seedbuf == NULL)
-            exit(1);
-
-        i = 0;
+            len += s.info[t].len;
+        uint64_t *seeds = (uint64_t*) malloc((len ? len : 1) * sizeof(*seeds));
+        if (seeds == NULL)
+            goto L_err;
+        len = 0;
         for (t = 0; t < threads; t++)
         {
-            linked_seeds_t *lp = &info[t].ls;
-            do
-            {
-                memcpy(*seedbuf + i, lp->seeds, lp->len * sizeof(uint64_t));
-                i += lp->len;
-                linked_seeds_t *tmp = lp;
-                lp = lp->next;
-                if (tmp != &info[t].ls)
-                    free(tmp);
-            }
-            while (lp);
+            memcpy(seeds + len, s.info[t].seeds, s.info[t].len * sizeof(*seeds));
+            len += s.info[t].len;
         }
+        qsort(seeds, len, sizeof(*seeds), cmp_seed);
+        *seedbuf = seeds;
+        *buflen = len;
     }
 
     if (0)
 L_err:
         err = 1;
 
-    free(tids);
-    free(info);
+    freeThreadPool(tp);
+    if (s.info)
+    {
+        for (t = 0; t < parts; t++)
+        {
+            if (s.info[t].fp)
+                fclose(s.info[t].fp);
+            free(s.info[t].seeds);
+        }
+    }
+    free(s.info);
+    free(s.done);
 
     return err;
 }
 
+int searchAll48(
+        uint64_t **         seedbuf,
+        uint64_t *          buflen,
+        const char *        path,
+        int                 threads,
+        const uint64_t *    lowBits,
+        int                 lowBitN,
+        int (*check)(uint64_t s48, void *data),
+        void *              data,
+        volatile char *     stop
+        )
+{
+    return runSearchAll48(seedbuf, buflen, path, threads, lowBits, lowBitN,
+            check, NULL, data, stop);
+}
+
+int searchAll48Lanes(
+        uint64_t **         seedbuf,
+        uint64_t *          buflen,
+        const char *        path,
+        int                 threads,
+        const uint64_t *    lowBits,
+        int                 lowBitN,
+        uint32_t (*checkLanes)(const uint64_t *seeds, void *data),
+        void *              data,
+        volatile char *     stop
+        )
+{
+    return runSearchAll48(seedbuf, buflen, path, threads, lowBits, lowBitN,
+            NULL, checkLanes, data, stop);
+}
+
+/* Tests the 'lanecnt' collected candidates and passes the quad-bases to 'fn'
+ * in order. Returns the first nonzero value of 'fn', otherwise zero.
+ */
+static int flushQuadLanes(const StructureConfig *sconf, int radius,
+        uint64_t *lane, const Pos *pos, int lanecnt,
+        int (*fn)(void *data, Pos qp), void *data)
+{
+    int k, ret;
+    if (lanecnt <= 0)
+        return 0;
+    for (k = lanecnt; k < LANE_CNT; k++)
+        lane[k] = lane[lanecnt-1];
+
+    uint32_t bits = isQuadBaseLanes(*sconf, lane, radius);
+    bits &= (1U << lanecnt) - 1;
+    for (k = 0; bits; k++, bits >>= 1)
+    {
+        if ((bits & 1) && (ret = fn(data, pos[k])))
+            return ret;
+    }
+    return 0;
+}
+
 static inline
 int scanForQuadBits(const StructureConfig sconf, int radius, uint64_t s48,
         uint64_t lbit, int lbitn, uint64_t invB, int64_t x, int64_t z,
-        int64_t w, int64_t h, Pos *qplist, int n)
+        int64_t w, int64_t h, int (*fn)(void *data, Pos qp), void *data)
 {
     const uint64_t m = (1ULL << lbitn);
     const uint64_t A = 341873128712ULL;
     // for lbitn=20: invB = 132477LL;
 
-    if (n < 1)
-        return 0;
     lbit &= m-1;
 
+    // the candidates are tested in batches with the lane checks
+    uint64_t lane[LANE_CNT];
+    Pos pos[LANE_CNT];
+    int lanecnt = 0;
+
     int64_t i, j;
-    int cnt = 0;
+    int ret;
     for (i = x; i <= x+w; i++)
     {
         uint64_t sx = s48 + A * i;
@@ -632,18 +1085,41 @@ int scanForQuadBits(const StructureConfig sconf, int radius, uint64_t s48,
             if ((sp & (m-1)) != lbit)
                 continue;
 
-            if (isQuadBase(sconf, sp, radius))
-            {
-                qplist[cnt].x = i;
-                qplist[cnt].z = j;
-                cnt++;
-                if (cnt >= n)
-                    return cnt;
-            }
+            lane[lanecnt] = sp;
+            pos[lanecnt].x = i;
+            pos[lanecnt].z = j;
+            if (++lanecnt < LANE_CNT)
+                continue;
+            ret = flushQuadLanes(&sconf, radius, lane, pos, lanecnt, fn, data);
+            lanecnt = 0;
+            if (ret)
+                return ret;
         }
     }
 
-    return cnt;
+    return flushQuadLanes(&sconf, radius, lane, pos, lanecnt, fn, data);
+}
+
+static uint64_t getQuadInvB(int lowBitN)
+{
+    if (lowBitN == 20)
+        return 132477ULL;
+    if (lowBitN == 48)
+        return 211541297333629ULL;
+    return mulInv(132897987541ULL, (1ULL << lowBitN));
+}
+
+STRUCT(quadlist_t)
+{
+    Pos *qplist;
+    int cnt, n;
+};
+
+static int addQuadToList(void *data, Pos qp)
+{
+    quadlist_t *ql = (quadlist_t*) data;
+    ql->qplist[ql->cnt++] = qp;
+    return ql->cnt >= ql->n;
 }
 
 int scanForQuads(
@@ -651,24 +1127,129 @@ int scanForQuads(
         const uint64_t *lowBits, int lowBitN, uint64_t salt,
         int x, int z, int w, int h, Pos *qplist, int n)
 {
-    int i, cnt = 0;
+    uint64_t invB = getQuadInvB(lowBitN);
+    quadlist_t ql = { qplist, 0, n };
+    int i;
+
+    for (i = 0; lowBits[i] && ql.cnt < n; i++)
+    {
+        scanForQuadBits(sconf, radius, s48, lowBits[i]-salt, lowBitN, invB,
+                x, z, w, h, addQuadToList, &ql);
+    }
+
+    return ql.cnt;
+}
+
+
+// Each strip of the scan gathers its quad-structures in its own list, which
+// are passed on in order once all strips of a lower bit subset are done.
+STRUCT(quadstrip_t)
+{
+    Pos *qp;
+    int len, cap;
+};
+
+STRUCT(quadscan_t)
+{
+    StructureConfig sconf;
+    int radius;
+    uint64_t s48;
+    uint64_t lbit;
+    int lbitn;
     uint64_t invB;
-    if (lowBitN == 20)
-        invB = 132477ULL;
-    else if (lowBitN == 48)
-        invB = 211541297333629ULL;
-    else
-        invB = mulInv(132897987541ULL, (1ULL << lowBitN));
+    int64_t x, z, w, h;
+    int64_t sw; // strip width
+    quadstrip_t *strips;
+};
 
-    for (i = 0; lowBits[i]; i++)
+static int addQuadToStrip(void *data, Pos qp)
+{
+    quadstrip_t *st = (quadstrip_t*) data;
+    if (st->len >= st->cap)
     {
-        cnt += scanForQuadBits(sconf, radius, s48, lowBits[i]-salt, lowBitN, invB,
-                x, z, w, h, qplist+cnt, n-cnt);
-        if (cnt >= n)
-            break;
+        int cap = st->cap ? 2 * st->cap : 16;
+        Pos *p = (Pos*) realloc(st->qp, cap * sizeof(*p));
+        if (p == NULL)
+            return 1;
+        st->qp = p;
+        st->cap = cap;
     }
+    st->qp[st->len++] = qp;
+    return 0;
+}
 
-    return cnt;
+static int scanQuadStrip(void *data, int task, int worker)
+{
+    const quadscan_t *qs = (const quadscan_t*) data;
+    int64_t x = qs->x + task * qs->sw;
+    int64_t w = qs->sw - 1;
+    if (x + w > qs->x + qs->w)
+        w = qs->x + qs->w - x;
+    (void) worker;
+
+    quadstrip_t *st = qs->strips + task;
+    st->len = 0;
+    return scanForQuadBits(qs->sconf, qs->radius, qs->s48, qs->lbit, qs->lbitn,
+            qs->invB, x, qs->z, w, qs->h, addQuadToStrip, st);
 }
 
+int scanForQuadsParallel(
+        const StructureConfig sconf, int radius, uint64_t s48,
+        const uint64_t *lowBits, int lowBitN, uint64_t salt,
+        int x, int z, int w, int h, ThreadPool *pool,
+        int (*fn)(void *data, Pos qp), void *data)
+{
+    int threads = pool ? getThreadCount(pool) : 1;
+    int i, k, t, err = 0;
+
+    quadscan_t qs;
+    qs.sconf = sconf;
+    qs.radius = radius;
+    qs.s48 = s48;
+    qs.lbitn = lowBitN;
+    qs.invB = getQuadInvB(lowBitN);
+    qs.x = x;
+    qs.z = z;
+    qs.w = w;
+    qs.h = h;
+
+    // a few strips per worker balance the load, but the strips should be
+    // wide enough to keep the lanes of the checks busy
+    int64_t cols = qs.w + 1;
+    qs.sw = (cols + 4 * threads - 1) / (4 * threads);
+    if (qs.sw < 256)
+        qs.sw = 256;
+    int stripcnt = (int)((cols + qs.sw - 1) / qs.sw);
+
+    qs.strips = (quadstrip_t*) calloc(stripcnt, sizeof(quadstrip_t));
+    if (qs.strips == NULL)
+        return -1;
+
+    for (i = 0; lowBits[i] && !err; i++)
+    {
+        qs.lbit = lowBits[i] - salt;
+        if (pool)
+        {
+            if (runThreadPool(pool, stripcnt, scanQuadStrip, &qs))
+                err = -1;
+        }
+        else
+        {
+            for (t = 0; t < stripcnt && !err; t++)
+                if (scanQuadStrip(&qs, t, 0))
+                    err = -1;
+        }
+
+        for (t = 0; t < stripcnt && !err; t++)
+        {
+            const quadstrip_t *st = qs.strips + t;
+            for (k = 0; k < st->len && !err; k++)
+                err = fn(data, st->qp[k]);
+        }
+    }
 
+    for (t = 0; t < stripcnt; t++)
+        free(qs.strips[t].qp);
+    free(qs.strips);
+    return err;
+}
@@ -135,6 +135,22 @@ static inline ATTR(always_inline, const)
 float isQuadBaseLarge (const StructureConfig sconf, uint64_t seed,
         int ax, int ay, int az, int radius);
 
+/* Lane variants of the quad-base checks, which test the LANE_CNT seeds of
+ * 'seeds' at once and return a bitmask in which bit i is set if seeds[i] is
+ * a quad-base. On processors with AVX-512, the opposing diagonal structures,
+ * which reject almost all seeds, are tested for all lanes at once in vector
+ * arithmetic. The remaining seeds are confirmed with the scalar checks above,
+ * so the results are identical.
+ */
+uint32_t isQuadBaseLanes(const StructureConfig sconf, const uint64_t *seeds,
+        int radius);
+uint32_t isQuadBaseFeature24Lanes(const StructureConfig sconf,
+        const uint64_t *seeds, int ax, int ay, int az);
+uint32_t isQuadBaseFeatureLanes(const StructureConfig sconf,
+        const uint64_t *seeds, int ax, int ay, int az, int radius);
+uint32_t isQuadBaseLargeLanes(const StructureConfig sconf,
+        const uint64_t *seeds, int ax, int ay, int az, int radius);
+
 
 /* Starts a multi-threaded search through all 48-bit seeds. Since this can
  * potentially be a lengthy calculation, results can be written to temporary
@@ -143,11 +159,21 @@ float isQuadBaseLarge (const StructureConfig sconf, uint64_t seed,
  * 'data' argument. The output can be a dynamically allocated seed buffer
  * and/or a destination file [which can be loaded using loadSavedSeeds()].
  * Optionally, only a subset of the lower 20 bits are searched.
+ * The seed space is handed out to the threads in blocks of 2^28 seeds (or of
+ * 2^lowBitN if larger), so that threads which finish early take over the
+ * remaining work. Each thread writes the results of its completed blocks to a
+ * binary progress file "<path>.part<N>" (see SeedFileHeader), which is synced
+ * to disk every few seconds. An interrupted search resumes exactly when it is
+ * restarted with the same path, using the progress files of all earlier runs,
+ * also when the number of threads has changed. The output file is synced
+ * before all progress files are removed. The output seeds are
+ * sorted in ascending order, and the output file is written as decimal text,
+ * or as a binary seed file if the path ends with ".bin".
  *
  * @seedbuf     output seed buffer (nullable for file only)
  * @buflen      length of output buffer (nullable)
  * @path        output file path (nullable, also toggles temporary files)
- * @threads     number of threads to use
+ * @threads     number of threads to use (zero or less for all processors)
  * @lowBits     lower bit subset (nullable)
  * @lowBitN     number of bits in the subset values
  * @check       the testing function, should return non-zero for desired seeds
@@ -168,6 +194,23 @@ int searchAll48(
         volatile char *     stop // should be atomic, but is fine as stop flag
         );
 
+/* Variant of searchAll48() that tests LANE_CNT seeds per call of 'checkLanes',
+ * such as with isQuadBaseLanes(), which returns a bitmask of the seeds that
+ * are kept (bit i for seeds[i]). Incomplete batches are padded with repeated
+ * seeds. The progress files are compatible with searchAll48().
+ */
+int searchAll48Lanes(
+        uint64_t **         seedbuf,
+        uint64_t *          buflen,
+        const char *        path,
+        int                 threads,
+        const uint64_t *    lowBits,
+        int                 lowBitN,
+        uint32_t (*checkLanes)(const uint64_t *seeds, void *data),
+        void *              data,
+        volatile char *     stop
+        );
+
 /* Finds the optimal AFK location for four structures of size (ax,ay,az),
  * located at the positions of 'p'. The AFK position is determined by looking
  * for whole block coordinates which offer the maximum number of spawning
@@ -207,6 +250,22 @@ int scanForQuads(
         const uint64_t *lowBits, int lowBitN, uint64_t salt,
         int x, int z, int w, int h, Pos *qplist, int n);
 
+/* Multi-threaded variant of scanForQuads() for large areas, which passes each
+ * quad-structure to the callback 'fn' instead of filling a buffer. For each of
+ * the lower bit subsets, the x-range of the area is divided into strips that
+ * are scanned by the workers of 'pool' (nullable for the calling thread). The
+ * quad-structures are passed to 'fn' in the same order as they are found by
+ * scanForQuads(). The scan ends when 'fn' returns nonzero.
+ *
+ * Returns zero upon success, the nonzero value returned by 'fn', or -1 if the
+ * scan failed.
+ */
+int scanForQuadsParallel(
+        const StructureConfig sconf, int radius, uint64_t s48,
+        const uint64_t *lowBits, int lowBitN, uint64_t salt,
+        int x, int z, int w, int h, ThreadPool *pool,
+        int (*fn)(void *data, Pos qp), void *data);
+
 
 //==============================================================================
 // Implementaions for Functions that Ideally Should be Inlined
@@ -173,6 +173,164 @@ uint32_t testAreas(int mc, int dim, int scale)
 }
 
 
+/* Compares the 1.18+ Overworld biomes at float32 precision (FLOAT32_NOISE) to
+ * those of the exact double precision sampling, over 'cnt' areas of (w x h)
+ * cells at the given scale that are spread around the world.
+ */
+uint64_t testFloat32Noise(int mc, int scale, int w, int h, int cnt)
+{
+    Generator g, gf;
+    setupGenerator(&g, mc, 0);
+    setupGenerator(&gf, mc, FLOAT32_NOISE);
+
+    double td = 0, tf = 0;
+    uint64_t diff = 0, tot = 0;
+    uint64_t s;
+    for (s = 0; s < (uint64_t) cnt; s++)
+    {
+        int d = 30000000 / scale;
+        int x = hash32(s << 5) % d - d/2;
+        int z = hash32(s << 9) % d - d/2;
+        int y = (((int)(hash32(s << 7) % 384) - 64) * 4 / scale);
+
+        applySeed(&g, DIM_OVERWORLD, s);
+        applySeed(&gf, DIM_OVERWORLD, s);
+        Range r = {scale, x, z, w, h, y, 1};
+        int *ids = allocCache(&g, r);
+        int *idf = allocCache(&gf, r);
+        td -= now();
+        genBiomes(&g, ids, r);
+        td += now();
+        tf -= now();
+        genBiomes(&gf, idf, r);
+        tf += now();
+
+        int i;
+        for (i = 0; i < w*h; i++)
+            diff += ids[i] != idf[i];
+        tot += w*h;
+        free(idf);
+        free(ids);
+    }
+    printf("  MC %-6s @ 1:%-3d - %llu of %llu biomes differ (%.2g ppm) "
+        "[double %ld msec, float32 %ld msec]\n",
+        mc2str(mc), scale, (unsigned long long) diff, (unsigned long long) tot,
+        1e6 * diff / tot, (long)(td*1e3), (long)(tf*1e3));
+    return diff;
+}
+
+
+
+/* Compares genBiomesParallel() to a single genBiomes() call over 'cnt' random
+ * ranges of up to (w x h) cells with 'sy' vertical cells, and returns the
+ * number of differing biomes. Nether volumes (sy > 1) and 1.18+ scales above
+ * 1:4 depend on the range and must not be split into tiles.
+ */
+uint64_t testParallelGen(int mc, int dim, int scale, int w, int h, int sy,
+    int cnt)
+{
+    Generator g;
+    setupGenerator(&g, mc, 0);
+    ThreadPool *pool = createThreadPool(4);
+    if (!pool)
+        return 1;
+
+    uint64_t diff = 0;
+    uint64_t s;
+    for (s = 0; s < (uint64_t) cnt; s++)
+    {
+        int d = 40000 / scale;
+        int x = hash32(s << 5) % d - d/2;
+        int z = hash32(s << 9) % d - d/2;
+        int y = (((int)(hash32(s << 7) % 256)) * 4 / scale);
+        int sx = 32 + hash32(s << 11) % w;
+        int sz = 32 + hash32(s << 13) % h;
+
+        applySeed(&g, dim, s);
+        Range r = {scale, x, z, sx, sz, y, sy};
+        int *ids = allocCache(&g, r);
+        int *idp = allocCache(&g, r);
+        if (!ids || !idp || genBiomes(&g, ids, r) ||
+            genBiomesParallel(&g, idp, r, pool))
+        {
+            diff++;
+        }
+        else
+        {
+            int64_t i, n = (int64_t) sx * sz * sy;
+            for (i = 0; i < n; i++)
+                diff += ids[i] != idp[i];
+        }
+        free(idp);
+        free(ids);
+    }
+    freeThreadPool(pool);
+    printf("  MC %-6s dim %-2d @ 1:%-3d sy=%d - %llu biomes differ\n",
+        mc2str(mc), dim, scale, sy, (unsigned long long) diff);
+    return diff;
+}
+
+
+/* Compares isViableStructurePos() and checkForBiomes() on a generator with an
+ * attached TileCache to the same checks without a cache, for the structures
+ * and spawn area of 'cnt' seeds, and returns the number of differing results. Small tiles make it likely that
+ * a check finds a tile that an earlier check has already generated.
+ */
+uint64_t testTileCacheChecks(int mc, int cnt)
+{
+    const int stypes[] = {
+        Desert_Pyramid, Jungle_Temple, Swamp_Hut, Igloo, Village, Ocean_Ruin,
+        Shipwreck, Monument, Mansion, Outpost, Ruined_Portal,
+    };
+    Generator g, gc;
+    TileCache tc;
+    setupGenerator(&g, mc, 0);
+    setupGenerator(&gc, mc, 0);
+    if (initTileCache(&tc, 16, 64) || setTileCache(&gc, &tc))
+        return 1;
+
+    const int req[] = { jungle, desert };
+    BiomeFilter bf;
+    setupBiomeFilter(&bf, mc, 0, req, 2, NULL, 0, NULL, 0);
+    Range r = {16, -64, -64, 128, 128, 0, 0};
+
+    uint64_t diff = 0, tot = 0;
+    uint64_t seed;
+    int i, rx, rz;
+    for (seed = 0; seed < (uint64_t) cnt; seed++)
+    {
+        applySeed(&g, DIM_OVERWORLD, seed);
+        applySeed(&gc, DIM_OVERWORLD, seed);
+        for (i = 0; i < (int) (sizeof(stypes) / sizeof(*stypes)); i++)
+        {
+            StructureConfig sconf;
+            if (!getStructureConfig(stypes[i], mc, &sconf))
+                continue;
+            for (rz = -8; rz < 8; rz++)
+            {
+                for (rx = -8; rx < 8; rx++)
+                {
+                    Pos p;
+                    if (!getStructurePos(stypes[i], mc, seed, rx, rz, &p))
+                        continue;
+                    int v0 = isViableStructurePos(stypes[i], &g, p.x, p.z, 0);
+                    int v1 = isViableStructurePos(stypes[i], &gc, p.x, p.z, 0);
+                    diff += !v0 != !v1;
+                    tot++;
+                }
+            }
+        }
+        int c0 = checkForBiomes(&g, NULL, r, DIM_OVERWORLD, seed, &bf, NULL);
+        int c1 = checkForBiomes(&gc, NULL, r, DIM_OVERWORLD, seed, &bf, NULL);
+        diff += c0 != c1;
+        tot++;
+    }
+    setTileCache(&gc, NULL);
+    freeTileCache(&tc);
+    printf("  MC %-6s - %llu of %llu checks differ with a TileCache\n",
+        mc2str(mc), (unsigned long long) diff, (unsigned long long) tot);
+    return diff;
+}
 
 
 int testGeneration()
@@ -532,6 +690,12 @@ int main()
     //testAreas(MC_1_21, 0, 4);
     //testAreas(mc, 0, 16);
     //testAreas(mc, 0, 256);
+    //for (int v = MC_1_18; v <= MC_NEWEST; v++)
+    //    testFloat32Noise(v, 4, 256, 256, 100);
+    //for (int v = MC_1_14; v <= MC_1_17; v++)
+    //    testTileCacheChecks(v, 20);
+    //testParallelGen(MC_1_21, DIM_NETHER, 4, 128, 128, 5, 100);
+    //testParallelGen(MC_1_21, DIM_OVERWORLD, 64, 128, 128, 1, 40);
     //testCanBiomesGenerate();
     //testGeneration();
     //findBiomeParaBounds();
@@ -0,0 +1,232 @@
+#include "threads.h"
+
+#include <stdlib.h>
+
+
+#if defined(_WIN32)
+
+#include <windows.h>
+typedef HANDLE              thread_id_t;
+typedef CRITICAL_SECTION    mutex_t;
+typedef CONDITION_VARIABLE  cond_t;
+#define mutexInit(M)        InitializeCriticalSection(M)
+#define mutexFree(M)        DeleteCriticalSection(M)
+#define mutexLock(M)        EnterCriticalSection(M)
+#define mutexUnlock(M)      LeaveCriticalSection(M)
+#define condInit(C)         InitializeConditionVariable(C)
+#define condFree(C)         ((void)(C))
+#define condWait(C,M)       SleepConditionVariableCS(C, M, INFINITE)
+#define condBroadcast(C)    WakeAllConditionVariable(C)
+
+#else
+
+#define USE_PTHREAD
+#include <pthread.h>
+#include <unistd.h>
+typedef pthread_t           thread_id_t;
+typedef pthread_mutex_t     mutex_t;
+typedef pthread_cond_t      cond_t;
+#define mutexInit(M)        pthread_mutex_init(M, NULL)
+#define mutexFree(M)        pthread_mutex_destroy(M)
+#define mutexLock(M)        pthread_mutex_lock(M)
+#define mutexUnlock(M)      pthread_mutex_unlock(M)
+#define condInit(C)         pthread_cond_init(C, NULL)
+#define condFree(C)         pthread_cond_destroy(C)
+#define condWait(C,M)       pthread_cond_wait(C, M)
+#define condBroadcast(C)    pthread_cond_broadcast(C)
+
+#endif
+
+
+struct ThreadPool;
+
+typedef struct
+{
+    struct ThreadPool *tp;
+    int id;
+} worker_t;
+
+struct ThreadPool
+{
+    int threads;
+    thread_id_t *tids;
+    worker_t *workers;
+
+    mutex_t lock;       // guards the job state below
+    mutex_t serial;     // serializes the jobs of concurrent callers
+    cond_t work;        // signals new tasks or shutdown
+    cond_t done;        // signals the completion of the job
+
+    int (*fn)(void *data, int task, int worker);
+    void *data;
+    int ntasks;         // number of tasks that will be started
+    int next;           // next task to start
+    int finished;       // number of completed tasks
+    int err;
+    int quit;
+};
+
+
+int getProcessorCount(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors > 0 ? (int) si.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int) n : 1;
+#endif
+}
+
+
+static void runWorker(worker_t *w)
+{
+    ThreadPool *tp = w->tp;
+
+    mutexLock(&tp->lock);
+    while (1)
+    {
+        while (!tp->quit && tp->next >= tp->ntasks)
+            condWait(&tp->work, &tp->lock);
+        if (tp->quit)
+            break;
+
+        int task = tp->next++;
+        mutexUnlock(&tp->lock);
+
+        int err = tp->fn(tp->data, task, w->id);
+
+        mutexLock(&tp->lock);
+        if (err && !tp->err)
+        {   // stop handing out tasks
+            tp->err = err;
+            tp->ntasks = tp->next;
+        }
+        if (++tp->finished == tp->ntasks)
+            condBroadcast(&tp->done);
+    }
+    mutexUnlock(&tp->lock);
+}
+
+#ifdef USE_PTHREAD
+static void *workerThread(void *data)
+{
+    runWorker((worker_t*) data);
+    return NULL;
+}
+#else
+static DWORD WINAPI workerThread(LPVOID data)
+{
+    runWorker((worker_t*) data);
+    return 0;
+}
+#endif
+
+
+ThreadPool *createThreadPool(int threads)
+{
+    if (threads <= 0)
+        threads = getProcessorCount();
+
+    ThreadPool *tp = (ThreadPool*) calloc(1, sizeof(ThreadPool));
+    if (!tp)
+        return NULL;
+    tp->tids = (thread_id_t*) malloc(threads * sizeof(*tp->tids));
+    tp->workers = (worker_t*) malloc(threads * sizeof(*tp->workers));
+    if (!tp->tids || !tp->workers)
+    {
+        free(tp->tids);
+        free(tp->workers);
+        free(tp);
+        return NULL;
+    }
+
+    mutexInit(&tp->lock);
+    mutexInit(&tp->serial);
+    condInit(&tp->work);
+    condInit(&tp->done);
+
+    for (tp->threads = 0; tp->threads < threads; tp->threads++)
+    {
+        worker_t *w = tp->workers + tp->threads;
+        w->tp = tp;
+        w->id = tp->threads;
+#ifdef USE_PTHREAD
+        if (pthread_create(&tp->tids[tp->threads], NULL, workerThread, w))
+            break;
+#else
+        tp->tids[tp->threads] = CreateThread(NULL, 0, workerThread, w, 0, NULL);
+        if (!tp->tids[tp->threads])
+            break;
+#endif
+    }
+
+    if (tp->threads < threads)
+    {
+        freeThreadPool(tp);
+        return NULL;
+    }
+    return tp;
+}
+
+void freeThreadPool(ThreadPool *tp)
+{
+    if (!tp)
+        return;
+
+    mutexLock(&tp->lock);
+    tp->quit = 1;
+    condBroadcast(&tp->work);
+    mutexUnlock(&tp->lock);
+
+    int t;
+#ifdef USE_PTHREAD
+    for (t = 0; t < tp->threads; t++)
+        pthread_join(tp->tids[t], NULL);
+#else
+    if (tp->threads > 0)
+        WaitForMultipleObjects(tp->threads, tp->tids, TRUE, INFINITE);
+    for (t = 0; t < tp->threads; t++)
+        CloseHandle(tp->tids[t]);
+#endif
+
+    condFree(&tp->work);
+    condFree(&tp->done);
+    mutexFree(&tp->serial);
+    mutexFree(&tp->lock);
+    free(tp->tids);
+    free(tp->workers);
+    free(tp);
+}
+
+int getThreadCount(const ThreadPool *tp)
+{
+    return tp->threads;
+}
+
+int runThreadPool(ThreadPool *tp, int n,
+        int (*fn)(void *data, int task, int worker), void *data)
+{
+    if (n <= 0)
+        return 0;
+
+    mutexLock(&tp->serial);
+    mutexLock(&tp->lock);
+    tp->fn = fn;
+    tp->data = data;
+    tp->next = 0;
+    tp->finished = 0;
+    tp->err = 0;
+    tp->ntasks = n;
+    condBroadcast(&tp->work);
+    while (tp->finished < tp->ntasks)
+        condWait(&tp->done, &tp->lock);
+    int err = tp->err;
+    tp->ntasks = tp->next = 0;
+    mutexUnlock(&tp->lock);
+    mutexUnlock(&tp->serial);
+
+    return err;
+}
+
@@ -0,0 +1,49 @@
+#ifndef THREADS_H_
+#define THREADS_H_
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* A pool of worker threads that can be reused for many parallel jobs, which
+ * avoids creating new threads for each call. A job consists of 'n' tasks,
+ * identified by their index, which are distributed dynamically among the
+ * workers. The task function receives the custom 'data' argument, the task
+ * index and the index of the worker that runs it (in the range [0,threads)),
+ * which can be used to select a per-thread scratch buffer.
+ */
+typedef struct ThreadPool ThreadPool;
+
+/* Starts a pool with the given number of workers. If 'threads' is zero or
+ * negative, the number of processors is used.
+ * Returns NULL upon failure.
+ */
+ThreadPool *createThreadPool(int threads);
+
+/* Finishes all workers and frees the pool. (Nullable) */
+void freeThreadPool(ThreadPool *tp);
+
+/* Returns the number of workers in the pool. */
+int getThreadCount(const ThreadPool *tp);
+
+/* Runs tasks 0 to n-1 of 'fn' in the pool and waits until all of them have
+ * completed. If a task returns nonzero, no further tasks are started, and the
+ * first such value is returned, otherwise zero. A pool runs a single job at a
+ * time, so the calls are serialized if multiple threads share the pool, and
+ * the tasks themselves must not run jobs in the same pool.
+ */
+int runThreadPool(ThreadPool *tp, int n,
+        int (*fn)(void *data, int task, int worker), void *data);
+
+/* Returns the number of processors that are available. */
+int getProcessorCount(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* THREADS_H_ */
+
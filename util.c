@@ -1,3 +1,7 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L // for mmap()
+#endif
+
 #include "util.h"
 #include "finders.h"
 
@@ -5,42 +9,594 @@
 #include <string.h>
 #include <stdlib.h>
 
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 
-uint64_t *loadSavedSeeds(const char *fnam, uint64_t *scnt)
+
+//==============================================================================
+// Seed Lists
+//==============================================================================
+
+/* Maps a file into memory for reading, falling back to reading it into an
+ * allocated buffer if the mapping is not possible. An empty file yields a
+ * non-null pointer with zero length.
+ */
+static char *mapFile(const char *path, size_t *len, int *mapped)
 {
-    FILE *fp = fopen(fnam, "r");
+    static char empty[1];
+    char *p = NULL;
+    *len = 0;
+    *mapped = 0;
 
-    uint64_t seed, i;
-    uint64_t *baseSeeds;
+#if defined(_WIN32)
+    HANDLE fh = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fh == INVALID_HANDLE_VALUE)
+        return NULL;
+    LARGE_INTEGER siz;
+    if (GetFileSizeEx(fh, &siz) && siz.QuadPart == 0)
+    {
+        CloseHandle(fh);
+        return empty;
+    }
+    if (GetFileSizeEx(fh, &siz) && (uint64_t)siz.QuadPart <= (size_t)-1)
+    {
+        HANDLE mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mh)
+        {
+            p = (char*) MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mh);
+        }
+        if (p)
+        {
+            *len = (size_t) siz.QuadPart;
+            *mapped = 1;
+        }
+    }
+    CloseHandle(fh);
+    if (p)
+        return p;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        if (st.st_size == 0)
+        {
+            close(fd);
+            return empty;
+        }
+        p = (char*) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+            p = NULL;
+        else
+        {
+            *len = st.st_size;
+            *mapped = 1;
+        }
+    }
+    close(fd);
+    if (p)
+        return p;
+#endif
 
+    // fallback: read the whole file
+    FILE *fp = fopen(path, "rb");
     if (fp == NULL)
         return NULL;
+    size_t cap = 1 << 16, n;
+    p = (char*) malloc(cap);
+    while (p && (n = fread(p + *len, 1, cap - *len, fp)) > 0)
+    {
+        *len += n;
+        if (*len == cap)
+        {
+            char *q = (char*) realloc(p, cap *= 2);
+            if (q == NULL)
+                free(p);
+            p = q;
+        }
+    }
+    fclose(fp);
+    if (p && *len == 0)
+    {
+        free(p);
+        p = empty;
+    }
+    return p;
+}
 
-    *scnt = 0;
+static void unmapFile(char *p, size_t len, int mapped)
+{
+    if (mapped)
+    {
+#if defined(_WIN32)
+        UnmapViewOfFile(p);
+        (void) len;
+#else
+        munmap(p, len);
+#endif
+    }
+    else if (len)
+    {
+        free(p);
+    }
+}
+
+static inline int isSpace(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/* Parses up to 'n' decimal seeds from the text [p, end) in the same way as
+ * repeated calls to fscanf("%" PRId64), skipping the rest of a line upon a
+ * parsing failure. Returns the number of seeds and updates 'p'.
+ */
+static size_t parseSeeds(const char **pp, const char *end, uint64_t *out, size_t n)
+{
+    const char *p = *pp;
+    size_t cnt = 0;
 
-    while (!feof(fp))
+    while (cnt < n)
     {
-        if (fscanf(fp, "%" PRId64, (int64_t*)&seed) == 1) (*scnt)++;
-        else while (!feof(fp) && fgetc(fp) != '\n');
+        while (p < end && isSpace(*p))
+            p++;
+        if (p >= end)
+            break;
+        const char *q = p;
+        int neg = 0;
+        if (*q == '-' || *q == '+')
+            neg = (*q++ == '-');
+        if (q < end && *q >= '0' && *q <= '9')
+        {
+            uint64_t x = 0;
+            for (; q < end && *q >= '0' && *q <= '9'; q++)
+                x = x * 10 + (*q - '0');
+            out[cnt++] = neg ? -x : x;
+            p = q;
+        }
+        else
+        {
+            while (p < end && *p != '\n')
+                p++;
+        }
     }
+    *pp = p;
+    return cnt;
+}
 
+struct SeedReader
+{
+    // text file
+    char *data;
+    size_t len;
+    int mapped;
+    const char *pos;
+    // binary file
+    FILE *fp;
+    SeedFileHeader hdr;
+    uint64_t *rec;      // decoded seeds of the current record
+    uint64_t reclen, recpos, reccap;
+};
+
+SeedReader *seedReaderOpen(const char *path)
+{
+    SeedReader *sr = (SeedReader*) calloc(1, sizeof(SeedReader));
+    if (sr == NULL)
+        return NULL;
+
+    sr->fp = fopen(path, "rb");
+    if (sr->fp == NULL)
+        goto L_err;
+    if (readSeedFileHeader(sr->fp, &sr->hdr) == 0)
+        return sr;
+    fclose(sr->fp);
+    sr->fp = NULL;
+
+    sr->data = mapFile(path, &sr->len, &sr->mapped);
+    if (sr->data == NULL)
+        goto L_err;
+    sr->pos = sr->data;
+    return sr;
+
+L_err:
+    seedReaderClose(sr);
+    return NULL;
+}
+
+size_t seedReaderNext(SeedReader *sr, uint64_t *seeds, size_t n)
+{
+    if (sr->fp == NULL)
+        return parseSeeds(&sr->pos, sr->data + sr->len, seeds, n);
+
+    size_t cnt = 0;
+    while (cnt < n)
+    {
+        if (sr->recpos >= sr->reclen)
+        {
+            uint32_t block;
+            sr->reclen = sr->recpos = 0;
+            int ret = readSeedRecord(sr->fp, &sr->hdr, &block,
+                &sr->rec, &sr->reclen, &sr->reccap);
+            if (ret < 0)
+                printf("seedReaderNext(): stopped at an incomplete record\n");
+            if (ret <= 0)
+                break;
+            continue;
+        }
+        size_t k = sr->reclen - sr->recpos;
+        if (k > n - cnt)
+            k = n - cnt;
+        memcpy(seeds + cnt, sr->rec + sr->recpos, k * sizeof(*seeds));
+        sr->recpos += k;
+        cnt += k;
+    }
+    return cnt;
+}
+
+void seedReaderClose(SeedReader *sr)
+{
+    if (sr == NULL)
+        return;
+    if (sr->fp)
+        fclose(sr->fp);
+    if (sr->data)
+        unmapFile(sr->data, sr->len, sr->mapped);
+    free(sr->rec);
+    free(sr);
+}
+
+uint64_t *loadSavedSeeds(const char *fnam, uint64_t *scnt)
+{
+    return loadSavedSeedsParallel(fnam, scnt, NULL);
+}
+
+
+STRUCT(seed_chunk_t)
+{
+    const char *begin, *end;
+    uint64_t *seeds;
+    size_t len;
+};
+
+static int parseSeedChunk(void *data, int task, int worker)
+{
+    (void) worker;
+    seed_chunk_t *c = (seed_chunk_t*) data + task;
+    size_t cap = 0, n;
+    const char *p = c->begin;
+    do
+    {
+        if (c->len == cap)
+        {
+            cap = cap ? 2 * cap : 1024;
+            uint64_t *s = (uint64_t*) realloc(c->seeds, cap * sizeof(*s));
+            if (s == NULL)
+                return 1;
+            c->seeds = s;
+        }
+        n = parseSeeds(&p, c->end, c->seeds + c->len, cap - c->len);
+        c->len += n;
+    }
+    while (n);
+    return 0;
+}
+
+uint64_t *loadSavedSeedsParallel(const char *fnam, uint64_t *scnt,
+        ThreadPool *pool)
+{
+    SeedReader *sr = seedReaderOpen(fnam);
+    uint64_t *seeds = NULL, cap = 0;
+    seed_chunk_t *chunks = NULL;
+    int i, chunkcnt = 1;
+
+    *scnt = 0;
+    if (sr == NULL)
+        return NULL;
+
+    if (sr->fp == NULL)
+    {   // text: parse chunks that are split at newlines
+        const char *end = sr->data + sr->len;
+        if (pool && sr->len >= (1 << 20))
+        {
+            chunkcnt = 4 * getThreadCount(pool);
+            if ((size_t) chunkcnt > sr->len >> 18)
+                chunkcnt = sr->len >> 18;
+        }
+        chunks = (seed_chunk_t*) calloc(chunkcnt, sizeof(*chunks));
+        if (chunks == NULL)
+            goto L_end;
+        const char *p = sr->data;
+        for (i = 0; i < chunkcnt; i++)
+        {
+            const char *q = sr->data + sr->len / chunkcnt * (i+1);
+            if (i == chunkcnt-1)
+                q = end;
+            if (q < p)
+                q = p;
+            while (q < end && q[-1] != '\n')
+                q++;
+            chunks[i].begin = p;
+            chunks[i].end = q;
+            p = q;
+        }
+        int err;
+        if (chunkcnt > 1)
+            err = runThreadPool(pool, chunkcnt, parseSeedChunk, chunks);
+        else
+            err = parseSeedChunk(chunks, 0, 0);
+        if (err)
+            goto L_end;
+
+        for (i = 0; i < chunkcnt; i++)
+            cap += chunks[i].len;
+        if (chunkcnt == 1)
+        {
+            seeds = chunks[0].seeds;
+            chunks[0].seeds = NULL;
+            *scnt = cap;
+        }
+        else if (cap && (seeds = (uint64_t*) malloc(cap * sizeof(*seeds))))
+        {
+            for (i = 0; i < chunkcnt; i++)
+            {
+                memcpy(seeds + *scnt, chunks[i].seeds,
+                    chunks[i].len * sizeof(*seeds));
+                *scnt += chunks[i].len;
+            }
+        }
+    }
+    else
+    {   // binary: decode the records sequentially
+        uint32_t block;
+        int ret;
+        while ((ret = readSeedRecord(sr->fp, &sr->hdr, &block,
+                &seeds, scnt, &cap)) > 0);
+        if (ret < 0)
+            printf("loadSavedSeeds(): stopped at an incomplete record\n");
+    }
+
+L_end:
+    if (chunks)
+    {
+        for (i = 0; i < chunkcnt; i++)
+            free(chunks[i].seeds);
+        free(chunks);
+    }
+    seedReaderClose(sr);
     if (*scnt == 0)
+    {
+        free(seeds);
         return NULL;
+    }
+    return seeds;
+}
+
+
+//==============================================================================
+// Binary Seed Files
+//==============================================================================
+
+#define SEED_FILE_MAGIC     "CBSF"
+#define SEED_FILE_VERSION   1
+#define SEED_HEADER_SIZE    40
+
+// FNV-1a
+static uint32_t hashBytes(uint32_t h, const uint8_t *p, size_t len)
+{
+    while (len--)
+        h = (h ^ *p++) * 16777619u;
+    return h;
+}
+#define HASH_INIT 2166136261u
 
-    baseSeeds = (uint64_t*) calloc(*scnt, sizeof(*baseSeeds));
+static void putU32(uint8_t *p, uint32_t x)
+{
+    int i;
+    for (i = 0; i < 4; i++)
+        p[i] = (uint8_t)(x >> 8*i);
+}
 
-    rewind(fp);
+static void putU64(uint8_t *p, uint64_t x)
+{
+    int i;
+    for (i = 0; i < 8; i++)
+        p[i] = (uint8_t)(x >> 8*i);
+}
 
-    for (i = 0; i < *scnt && !feof(fp);)
+static uint32_t getU32(const uint8_t *p)
+{
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+        (uint32_t)p[3] << 24;
+}
+
+static uint64_t getU64(const uint8_t *p)
+{
+    return getU32(p) | (uint64_t)getU32(p+4) << 32;
+}
+
+void initSeedFileHeader(SeedFileHeader *hdr, int blockBits,
+        const uint64_t *lowBits, int lowBitN, uint64_t start, uint64_t end)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->blockBits = blockBits;
+    hdr->lowHash = HASH_INIT;
+    if (lowBits)
     {
-        if (fscanf(fp, "%" PRId64, (int64_t*)&baseSeeds[i]) == 1) i++;
-        else while (!feof(fp) && fgetc(fp) != '\n');
+        hdr->lowBitN = lowBitN;
+        for (; lowBits[hdr->lowCnt]; hdr->lowCnt++)
+        {
+            uint8_t b[8];
+            putU64(b, lowBits[hdr->lowCnt]);
+            hdr->lowHash = hashBytes(hdr->lowHash, b, 8);
+        }
     }
+    hdr->start = start;
+    hdr->end = end;
+}
 
-    fclose(fp);
+int writeSeedFileHeader(FILE *fp, const SeedFileHeader *hdr)
+{
+    uint8_t b[SEED_HEADER_SIZE];
+    memcpy(b, SEED_FILE_MAGIC, 4);
+    b[4] = SEED_FILE_VERSION;
+    b[5] = (uint8_t) hdr->blockBits;
+    b[6] = (uint8_t) hdr->lowBitN;
+    b[7] = 0;
+    putU32(b+8, hdr->lowCnt);
+    putU32(b+12, hdr->lowHash);
+    putU64(b+16, hdr->start);
+    putU64(b+24, hdr->end);
+    putU32(b+32, 0);
+    putU32(b+36, hashBytes(HASH_INIT, b, 36));
+    return fwrite(b, sizeof(b), 1, fp) != 1;
+}
+
+int readSeedFileHeader(FILE *fp, SeedFileHeader *hdr)
+{
+    uint8_t b[SEED_HEADER_SIZE];
+    if (fread(b, sizeof(b), 1, fp) != 1)
+        return 1;
+    if (memcmp(b, SEED_FILE_MAGIC, 4) != 0 || b[4] != SEED_FILE_VERSION)
+        return 1;
+    if (getU32(b+36) != hashBytes(HASH_INIT, b, 36))
+        return 1;
+    hdr->blockBits = b[5];
+    hdr->lowBitN = b[6];
+    hdr->lowCnt = getU32(b+8);
+    hdr->lowHash = getU32(b+12);
+    hdr->start = getU64(b+16);
+    hdr->end = getU64(b+24);
+    return 0;
+}
+
+/* A record consists of the block index, the number of seeds, the size of the
+ * payload, and a checksum over these and the payload. The payload holds the
+ * offset of the first seed to the start of the block, and then the difference
+ * to the previous seed for the remaining ones, each as a varint.
+ */
+int writeSeedRecord(FILE *fp, const SeedFileHeader *hdr, uint32_t block,
+        const uint64_t *seeds, uint32_t n)
+{
+    uint8_t head[12], tail[4], buf[1024];
+    uint64_t prev = (uint64_t)block << hdr->blockBits;
+    uint32_t i, size = 0;
 
-    return baseSeeds;
+    for (i = 0; i < n; i++)
+    {
+        uint64_t d = seeds[i] - prev;
+        prev = seeds[i];
+        do size++; while (d >>= 7);
+    }
+    putU32(head, block);
+    putU32(head+4, n);
+    putU32(head+8, size);
+    uint32_t h = hashBytes(HASH_INIT, head, sizeof(head));
+    if (fwrite(head, sizeof(head), 1, fp) != 1)
+        return 1;
+
+    size_t len = 0;
+    prev = (uint64_t)block << hdr->blockBits;
+    for (i = 0; i < n; i++)
+    {
+        uint64_t d = seeds[i] - prev;
+        prev = seeds[i];
+        for (; d >= 0x80; d >>= 7)
+            buf[len++] = (uint8_t)(d | 0x80);
+        buf[len++] = (uint8_t)d;
+        if (len > sizeof(buf) - 10 || i == n-1)
+        {
+            h = hashBytes(h, buf, len);
+            if (fwrite(buf, 1, len, fp) != len)
+                return 1;
+            len = 0;
+        }
+    }
+    putU32(tail, h);
+    return fwrite(tail, sizeof(tail), 1, fp) != 1;
+}
+
+int readSeedRecord(FILE *fp, const SeedFileHeader *hdr, uint32_t *block,
+        uint64_t **seeds, uint64_t *n, uint64_t *cap)
+{
+    uint8_t head[12], tail[4], buf[1024];
+    size_t got = fread(head, 1, sizeof(head), fp);
+    if (got == 0)
+        return 0;
+    if (got != sizeof(head))
+        return -1;
+
+    *block = getU32(head);
+    uint32_t cnt = getU32(head+4);
+    uint32_t size = getU32(head+8);
+    uint32_t h = hashBytes(HASH_INIT, head, sizeof(head));
+    uint64_t n0 = *n;
+    uint64_t prev = (uint64_t)*block << hdr->blockBits;
+    uint64_t d = 0;
+    int shift = 0;
+
+    if (size < cnt || size > 10 * (uint64_t)cnt)
+        return -1;
+
+    while (size > 0)
+    {
+        size_t len = size < sizeof(buf) ? size : sizeof(buf);
+        if (fread(buf, 1, len, fp) != len)
+            goto L_bad;
+        h = hashBytes(h, buf, len);
+        size -= len;
+
+        // Each seed takes at least one byte, so the buffer only grows with the
+        // payload that was actually read, rather than with the unverified count
+        // of a torn or corrupted record.
+        uint64_t need = *n + (cnt - (*n - n0) < len ? cnt - (*n - n0) : len);
+        if (need > *cap)
+        {
+            uint64_t c = *cap ? *cap : 1024;
+            while (c < need)
+                c *= 2;
+            uint64_t *p = (uint64_t*) realloc(*seeds, c * sizeof(*p));
+            if (p == NULL)
+                goto L_bad;
+            *seeds = p;
+            *cap = c;
+        }
+
+        size_t i;
+        for (i = 0; i < len; i++)
+        {
+            if (shift > 63)
+                goto L_bad;
+            d |= (uint64_t)(buf[i] & 0x7f) << shift;
+            shift += 7;
+            if (buf[i] & 0x80)
+                continue;
+            if (*n - n0 >= cnt)
+                goto L_bad;
+            prev += d;
+            (*seeds)[(*n)++] = prev;
+            d = 0;
+            shift = 0;
+        }
+    }
+    if (fread(tail, sizeof(tail), 1, fp) != 1 || getU32(tail) != h)
+        goto L_bad;
+    if (*n - n0 != cnt || shift != 0)
+        goto L_bad;
+    return 1;
+
+L_bad:
+    *n = n0;
+    return -1;
 }
 
 
@@ -518,6 +1074,27 @@ int parseBiomeColors(unsigned char biomeColors[256][3], const char *buf)
 }
 
 
+static void setPixelBlock(unsigned char *pixels, const unsigned char *rgb,
+        unsigned int i, unsigned int j, unsigned int sx, unsigned int sy,
+        unsigned int pixscale, int flip)
+{
+    unsigned int m, n;
+    for (m = 0; m < pixscale; m++) {
+        for (n = 0; n < pixscale; n++) {
+            int idx = pixscale * i + n;
+            if (flip)
+                idx += (sx * pixscale) * ((pixscale * j) + m);
+            else
+                idx += (sx * pixscale) * ((pixscale * (sy-1-j)) + m);
+
+            unsigned char *pix = pixels + 3*idx;
+            pix[0] = rgb[0];
+            pix[1] = rgb[1];
+            pix[2] = rgb[2];
+        }
+    }
+}
+
 int biomesToImage(unsigned char *pixels,
         unsigned char biomeColors[256][3], const int *biomes,
         const unsigned int sx, const unsigned int sy,
@@ -548,27 +1125,32 @@ int biomesToImage(unsigned char *pixels,
                 b = biomeColors[id][2];
             }
 
-            unsigned int m, n;
-            for (m = 0; m < pixscale; m++) {
-                for (n = 0; n < pixscale; n++) {
-                    int idx = pixscale * i + n;
-                    if (flip)
-                        idx += (sx * pixscale) * ((pixscale * j) + m);
-                    else
-                        idx += (sx * pixscale) * ((pixscale * (sy-1-j)) + m);
-
-                    unsigned char *pix = pixels + 3*idx;
-                    pix[0] = (unsigned char)r;
-                    pix[1] = (unsigned char)g;
-                    pix[2] = (unsigned char)b;
-                }
-            }
+            unsigned char rgb[3] = {
+                (unsigned char)r, (unsigned char)g, (unsigned char)b
+            };
+            setPixelBlock(pixels, rgb, i, j, sx, sy, pixscale, flip);
         }
     }
 
     return containsInvalidBiomes;
 }
 
+void biomesU8ToImage(unsigned char *pixels,
+        unsigned char biomeColors[256][3], const uint8_t *biomes,
+        const unsigned int sx, const unsigned int sy,
+        const unsigned int pixscale, const int flip)
+{
+    unsigned int i, j;
+    for (j = 0; j < sy; j++)
+    {
+        for (i = 0; i < sx; i++)
+        {
+            const unsigned char *rgb = biomeColors[biomes[j*sx+i]];
+            setPixelBlock(pixels, rgb, i, j, sx, sy, pixscale, flip);
+        }
+    }
+}
+
 int savePPM(const char *path, const unsigned char *pixels, const unsigned int sx, const unsigned int sy)
 {
     FILE *fp = fopen(path, "wb");
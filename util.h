@@ -2,7 +2,11 @@
 #define UTIL_H_
 
 
+#include "rng.h"
+#include "threads.h"
+
 #include <stdint.h>
+#include <stdio.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -10,7 +14,8 @@ extern "C"
 #endif
 
 /* Loads a list of seeds from a file. The seeds should be written as decimal
- * ASCII numbers separated by newlines.
+ * ASCII numbers separated by newlines, or the file should be a binary seed
+ * file (see below).
  * @fnam: file path
  * @scnt: number of valid seeds found in the file, which is also the number of
  *        elements in the returned buffer
@@ -19,6 +24,69 @@ extern "C"
  */
 uint64_t *loadSavedSeeds(const char *fnam, uint64_t *scnt);
 
+/* Same as loadSavedSeeds(), but large text files are split into chunks at line
+ * breaks, which are parsed concurrently by the workers of 'pool'. (Nullable)
+ */
+uint64_t *loadSavedSeedsParallel(const char *fnam, uint64_t *scnt,
+        ThreadPool *pool);
+
+/* A SeedReader streams the seeds of a file in the formats of loadSavedSeeds(),
+ * so that long seed lists can be processed in batches without loading them
+ * completely. Text files are memory mapped and parsed as the seeds are read.
+ *
+ * seedReaderOpen() returns NULL if the file cannot be opened.
+ * seedReaderNext() fills 'seeds' with up to 'n' of the next seeds and returns
+ * their number, which is zero once the end of the file is reached.
+ */
+typedef struct SeedReader SeedReader;
+
+SeedReader *seedReaderOpen(const char *path);
+size_t seedReaderNext(SeedReader *sr, uint64_t *seeds, size_t n);
+void seedReaderClose(SeedReader *sr);
+
+
+/* Binary seed files store the results of a 48-bit search compactly (see
+ * searchAll48()). A file begins with a header that describes the search,
+ * followed by a sequence of records. Each record holds the seeds that were
+ * found in one block of the search space in ascending order, stored as varint
+ * deltas and protected by a checksum, so that an incomplete record at the end
+ * of the file can be detected. All numbers are little-endian.
+ */
+STRUCT(SeedFileHeader)
+{
+    int blockBits;      // size of the blocks, as a power of two
+    int lowBitN;        // number of bits of the lower bit subset (or zero)
+    uint32_t lowCnt;    // number of values in the lower bit subset
+    uint32_t lowHash;   // hash of the lower bit subset
+    uint64_t start;     // searched seed range [start, end)
+    uint64_t end;
+};
+
+/* Initializes a header for a search with an optional lower bit subset. */
+void initSeedFileHeader(SeedFileHeader *hdr, int blockBits,
+        const uint64_t *lowBits, int lowBitN, uint64_t start, uint64_t end);
+
+/* Writes/reads the header at the start of a binary seed file, and returns
+ * zero upon success. Reading fails if the file is not a binary seed file.
+ */
+int writeSeedFileHeader(FILE *fp, const SeedFileHeader *hdr);
+int readSeedFileHeader(FILE *fp, SeedFileHeader *hdr);
+
+/* Writes a record with the 'n' ascending seeds of a block.
+ * Returns zero upon success.
+ */
+int writeSeedRecord(FILE *fp, const SeedFileHeader *hdr, uint32_t block,
+        const uint64_t *seeds, uint32_t n);
+
+/* Reads the next record and appends its seeds to the buffer '*seeds' of length
+ * '*n', which is reallocated as needed while tracking its capacity in '*cap'.
+ * The block index of the record is written to 'block'.
+ * Returns 1 if a record was read, 0 at the end of the file, and -1 if the
+ * record is incomplete or corrupted.
+ */
+int readSeedRecord(FILE *fp, const SeedFileHeader *hdr, uint32_t *block,
+        uint64_t **seeds, uint64_t *n, uint64_t *cap);
+
 
 /// convert between version enum and text
 const char* mc2str(int mc);
@@ -47,6 +115,14 @@ int biomesToImage(unsigned char *pixels,
         const unsigned int sx, const unsigned int sy,
         const unsigned int pixscale, const int flip);
 
+/* Like biomesToImage(), but for the 8-bit biome ids of genBiomesU8(), which
+ * always index the colormap directly (with none stored as 0xff).
+ */
+void biomesU8ToImage(unsigned char *pixels,
+        unsigned char biomeColors[256][3], const uint8_t *biomes,
+        const unsigned int sx, const unsigned int sy,
+        const unsigned int pixscale, const int flip);
+
 /* Save the pixel buffer (e.g. from biomesToImage) to the given path as an PPM
  * image file. Returns 0 if successful, or -1 if the file could not be opened,
  * or 1 if not all the pixel data could be written to the file.